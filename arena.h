@@ -0,0 +1,189 @@
+//-----------------------------------------------------------------------------
+/*!
+   \file
+   \brief A simple arena (bump) allocator for Observables.
+
+   The factory functions "of", "from", "throwError" and "map" create their observables with "new" - and
+   nobody ever deletes them. That's fine for a demo, but a service that builds and tears down thousands of
+   short-lived pipelines would leak and hit the global allocator for each and every observable.
+
+   So the factories accept an ObservableArena as an additional argument. The observables are then placed into
+   the memory blocks of the arena - by just "bumping" a pointer. "release" destroys all of them at once and
+   rewinds the arena. The memory blocks are kept for reuse. So once the arena has grown to the size needed by a
+   pipeline, constructing (and releasing) the pipeline again doesn't allocate any memory at all.
+
+   An arena is not thread safe. Use one arena per pipeline (or per thread).
+*/
+//-----------------------------------------------------------------------------
+#ifndef ARENA_H
+#define ARENA_H
+
+/* -- Includes ------------------------------------------------------------ */
+#include <stddef.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <new>
+#include <utility>
+#include <type_traits>
+
+
+/* -- Types --------------------------------------------------------------- */
+
+class ObservableArena
+{
+private:
+   //header of each memory block. the usable memory follows directly after it
+   struct Block
+   {
+      Block * next;
+      size_t size; //usable size
+   };
+
+   //objects that need a destructor call on "release" are registered by means of this list
+   struct Finalizer
+   {
+      void (*destroy)(void * object);
+      void * object;
+      Finalizer * next;
+   };
+
+
+   Block * first; //first block in the list
+   Block * current; //the block, memory is currently taken from
+   size_t offset; //offset of free memory within the current block
+   size_t blockSize;
+   size_t blockCount;
+   Finalizer * finalizers;
+
+
+   //copying an arena makes no sense
+   ObservableArena(ObservableArena const &);
+   ObservableArena & operator=(ObservableArena const &);
+
+
+   static unsigned char * memoryOf(Block * block)
+   {
+      return (unsigned char *)(block + 1);
+   }
+
+   template <typename T>
+   static void destroy(void * object)
+   {
+      ((T *)object)->~T();
+   }
+
+   //get a new block (at least "size" bytes) and append it after the current one
+   Block * grow(size_t size)
+   {
+      if (size < blockSize) size = blockSize;
+      Block * block = (Block *)malloc(sizeof(Block) + size);
+      if (block == nullptr) throw std::bad_alloc();
+      block->size = size;
+      blockCount++;
+      if (current == nullptr)
+      {
+         block->next = nullptr;
+         first = block;
+      }
+      else
+      {
+         block->next = current->next;
+         current->next = block;
+      }
+      return block;
+   }
+
+
+public:
+   //"blockSize" is the size of the memory blocks the arena allocates when it runs out of memory
+   explicit ObservableArena(size_t blockSize = 4096)
+   {
+      this->first = nullptr;
+      this->current = nullptr;
+      this->offset = 0;
+      this->blockSize = blockSize;
+      this->blockCount = 0;
+      this->finalizers = nullptr;
+   }
+
+   ~ObservableArena()
+   {
+      release();
+      while (first != nullptr)
+      {
+         Block * next = first->next;
+         free(first);
+         first = next;
+      }
+   }
+
+
+   //get "size" bytes of memory, aligned to "align" (which must be a power of two)
+   void * allocate(size_t size, size_t align)
+   {
+      //try the current block first, then the (already allocated) blocks after it
+      while (current != nullptr)
+      {
+         uintptr_t base = (uintptr_t)memoryOf(current);
+         size_t start = (size_t)(((base + offset + align - 1) & ~(uintptr_t)(align - 1)) - base);
+         if (start + size <= current->size)
+         {
+            offset = start + size;
+            return memoryOf(current) + start;
+         }
+         if (current->next == nullptr) break;
+         current = current->next;
+         offset = 0;
+      }
+      //out of memory: get a new block
+      current = grow(size + align);
+      offset = 0;
+      return allocate(size, align);
+   }
+
+
+   //construct an object of type T in the arena.
+   //if T needs a destructor call, it is registered to be destroyed on "release"
+   template <typename T, typename... Args>
+   T * make(Args &&... args)
+   {
+      Finalizer * finalizer = nullptr;
+      if (!std::is_trivially_destructible<T>::value)
+      {
+         finalizer = (Finalizer *)allocate(sizeof(Finalizer), alignof(Finalizer));
+      }
+      T * object = new (allocate(sizeof(T), alignof(T))) T(std::forward<Args>(args)...);
+      if (finalizer != nullptr)
+      {
+         finalizer->destroy = &ObservableArena::destroy<T>;
+         finalizer->object = object;
+         finalizer->next = finalizers;
+         finalizers = finalizer;
+      }
+      return object;
+   }
+
+
+   //destroy all objects (in reverse order of their construction) and rewind the arena.
+   //the memory blocks are kept for reuse
+   void release()
+   {
+      while (finalizers != nullptr)
+      {
+         Finalizer * finalizer = finalizers;
+         finalizers = finalizer->next;
+         finalizer->destroy(finalizer->object);
+      }
+      current = first;
+      offset = 0;
+   }
+
+
+   //number of memory blocks the arena has allocated (so far)
+   size_t blocks() const
+   {
+      return blockCount;
+   }
+};
+
+#endif
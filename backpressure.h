@@ -0,0 +1,222 @@
+//-----------------------------------------------------------------------------
+/*!
+   \file
+   \brief Backpressure strategies for observables that aren't demand-aware.
+
+   A demand-aware observable ("of", "from") emits only as many values as its observer has requested (see
+   Subscription::request). Other observables - like a subject, that passes on what it gets - just push their
+   values, no matter what was requested.
+
+   The BackpressureObserver (to be used with "map") sits in between: it accepts all values of the upstream,
+   but passes on only as many values as the observer has requested. The values in excess are kept in a
+   bounded buffer (allocated once at construction). What happens, if the buffer is full, is up to the strategy:
+
+   - Buffer: the buffer overflows. the observer gets "overflowError" (and complete), the upstream gets unsubscribed
+   - DropNewest: the incoming values are dropped (the buffer keeps the oldest ones)
+   - KeepLatest: the oldest buffered values are dropped (the buffer keeps the latest ones)
+
+      BackpressureObserver<int, char const *> latest(BackpressureObserver<int, char const *>::KeepLatest, 1, "overflow");
+      subject.map(latest)->subscribe(slowObserver); //slowObserver requests values in its own pace
+*/
+//-----------------------------------------------------------------------------
+#ifndef BACKPRESSURE_H
+#define BACKPRESSURE_H
+
+/* -- Includes ------------------------------------------------------------ */
+#include <stddef.h>
+#include <mutex>
+#include "observable.h"
+
+
+/* -- Types --------------------------------------------------------------- */
+
+template <typename V, typename E>
+class BackpressureObserver : public MappingObserver<V,E>
+{
+public:
+   enum Strategy
+   {
+      Buffer,
+      DropNewest,
+      KeepLatest
+   };
+
+   BackpressureObserver(Strategy strategy, size_t capacity, E overflowError)
+   {
+      this->strategy = strategy;
+      this->capacity = (capacity > 0) ? capacity : 1;
+      this->buffer = new V[this->capacity];
+      this->head = 0;
+      this->count = 0;
+      this->demand = 0;
+      this->dropped = 0;
+      this->draining = false;
+      this->missed = false;
+      this->completed = false;
+      this->failed = false;
+      this->errorSent = false;
+      this->completeSent = false;
+      this->overflowError = overflowError;
+   }
+
+   ~BackpressureObserver()
+   {
+      delete[] buffer;
+   }
+
+   //all values of the upstream are accepted
+   void start(Subscription * subscription)
+   {
+      this->subscription = subscription;
+      subscription->request(Subscription::UNBOUNDED);
+   }
+
+   //the demand of the observer
+   void request(size_t n)
+   {
+      std::unique_lock<std::mutex> lock(mutex);
+      demand = ((Subscription::UNBOUNDED - demand) > n) ? (demand + n) : Subscription::UNBOUNDED;
+      drain(lock);
+   }
+
+   void next(V const & value)
+   {
+      nextBatch(&value, 1);
+   }
+
+   void nextBatch(V const * values, size_t n)
+   {
+      std::unique_lock<std::mutex> lock(mutex);
+      if (failed || completed) return;
+      for (size_t i = 0; i < n; i++)
+      {
+         if ((count == capacity) && (demand > 0)) drain(lock); //make room by delivering the requested values first
+         if (count == capacity)
+         {
+            if (strategy == DropNewest)
+            {
+               dropped += n - i;
+               break;
+            }
+            if (strategy == KeepLatest)
+            {
+               head = (head + 1) % capacity;
+               count--;
+               dropped++;
+            }
+            else //Buffer: overflow
+            {
+               count = 0;
+               failed = true;
+               err = overflowError;
+               completed = true;
+               lock.unlock();
+               this->subscription->unsubscribe(); //stop the upstream
+               lock.lock();
+               break;
+            }
+         }
+         buffer[(head + count) % capacity] = values[i];
+         count++;
+      }
+      drain(lock);
+   }
+
+   void error(E const & err)
+   {
+      std::unique_lock<std::mutex> lock(mutex);
+      if (failed || completed) return;
+      this->err = err;
+      failed = true;
+      drain(lock);
+   }
+
+   void complete()
+   {
+      std::unique_lock<std::mutex> lock(mutex);
+      if (completed) return;
+      completed = true;
+      drain(lock);
+   }
+
+   //number of values, that were dropped (so far)
+   size_t droppedCount()
+   {
+      std::lock_guard<std::mutex> lock(mutex);
+      return dropped;
+   }
+
+private:
+   static const size_t CHUNK = 64; //max. number of values passed at once to the observer
+
+   Strategy strategy;
+   V * buffer; //ring buffer
+   size_t capacity;
+   size_t head; //index of the oldest buffered value
+   size_t count; //number of buffered values
+   size_t demand; //requested, but not yet delivered values
+   size_t dropped;
+   bool draining; //a thread is delivering values right now
+   bool missed; //something has changed, while a thread was delivering values
+   bool completed; //the upstream has completed (or the buffer has overflown)
+   bool failed; //the upstream has emitted an error (or the buffer has overflown)
+   bool errorSent; //the error has been passed on to the observer
+   bool completeSent; //complete has been passed on to the observer
+   E err;
+   E overflowError;
+   std::mutex mutex;
+
+   //copying makes no sense (the buffer would be shared)
+   BackpressureObserver(BackpressureObserver const &);
+   BackpressureObserver & operator=(BackpressureObserver const &);
+
+
+   //deliver the buffered values (as many as requested), followed by error/complete once the buffer is empty.
+   //the observer is notified without holding the lock (it may request further values from within "next").
+   //only one thread at a time delivers. a thread, that finds another one delivering, just flags "missed"
+   void drain(std::unique_lock<std::mutex> & lock)
+   {
+      if (draining)
+      {
+         missed = true;
+         return;
+      }
+      draining = true;
+      V chunk[CHUNK];
+      for (;;)
+      {
+         missed = false;
+         while ((demand > 0) && (count > 0))
+         {
+            size_t n = count;
+            if (n > CHUNK) n = CHUNK;
+            if (n > demand) n = demand;
+            for (size_t i = 0; i < n; i++) chunk[i] = buffer[(head + i) % capacity];
+            head = (head + n) % capacity;
+            count -= n;
+            if (demand != Subscription::UNBOUNDED) demand -= n;
+            lock.unlock();
+            this->observer->nextBatch(chunk, n);
+            lock.lock();
+         }
+         if ((count == 0) && failed && !errorSent)
+         {
+            errorSent = true;
+            lock.unlock();
+            this->observer->error(err);
+            lock.lock();
+         }
+         if ((count == 0) && completed && !completeSent)
+         {
+            completeSent = true;
+            lock.unlock();
+            this->observer->complete();
+            lock.lock();
+         }
+         if (!missed) break;
+      }
+      draining = false;
+   }
+};
+
+#endif
@@ -0,0 +1,509 @@
+//-----------------------------------------------------------------------------
+/*!
+   \file
+   \brief Benchmarks of the Observable implementation.
+
+   Measures the cost of the building blocks, to compare releases (and to see, whether an optimization pays off):
+
+   - emission: "from" (batch and value by value) compared to a raw loop over the values - and a fused pipeline
+     (pipeline.h) compared to the same map and filter as a raw loop
+   - chain depth: the cost per "map" stage, as the number of stages grows
+   - subscription: the cost of building, subscribing and unsubscribing a pipeline - and of a subject subscription
+   - fan-out: a subject, that passes the values on to N observers
+   - allocations: the number of heap allocations per pipeline (heap, arena, reused arena, cold definition)
+   - sink: writing the values as text (to /dev/null) - by the WriteSink compared to "<< endl"
+
+   Each case runs (at least) MIN_TIME and reports the best of REPEATS runs. Build it with optimizations:
+
+      g++ -std=c++17 -O2 bench.cpp -o bench -pthread && ./bench
+*/
+//-----------------------------------------------------------------------------
+
+/* -- Includes ------------------------------------------------------------ */
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <atomic>
+#include <chrono>
+#include <fstream>
+#include "observable.h"
+#include "cold.h"
+#include "pipeline.h"
+#include "subject.h"
+#include "sink.h"
+
+
+/* -- Defines ------------------------------------------------------------- */
+static const double MIN_TIME = 0.1; //seconds per run
+static const int REPEATS = 3;
+static const size_t VALUES = 1 << 16; //values per emission
+
+
+/* -- Types --------------------------------------------------------------- */
+
+typedef Observable<int, char const *> IntObservable;
+
+
+//sums up the values. gets the batches as a whole
+class SumObserver : public Observer<int, char const *>
+{
+public:
+   int64_t sum;
+
+   SumObserver()
+   {
+      sum = 0;
+   }
+
+   void next(int const & value)
+   {
+      sum += value;
+   }
+
+   void nextBatch(int const * values, size_t count)
+   {
+      int64_t s = 0;
+      for (size_t i = 0; i < count; i++) s += values[i];
+      sum += s;
+   }
+
+   void error(char const * const &) { }
+   void complete() { }
+};
+
+
+//sums up the values. gets the values one after the other (by means of Observer::nextBatch)
+class SumValueObserver : public Observer<int, char const *>
+{
+public:
+   int64_t sum;
+
+   SumValueObserver()
+   {
+      sum = 0;
+   }
+
+   void next(int const & value)
+   {
+      sum += value;
+   }
+
+   void error(char const * const &) { }
+   void complete() { }
+};
+
+
+//requests nothing. (so subscribing doesn't emit anything)
+class IdleObserver : public Observer<int, char const *>
+{
+public:
+   void start(Subscription * subscription)
+   {
+      this->subscription = subscription;
+   }
+
+   void next(int const &) { }
+   void error(char const * const &) { }
+   void complete() { }
+};
+
+
+//a "map" stage, that increments the values chunk-wise and forwards each chunk as a batch
+class IncrementObserver : public MappingObserver<int, char const *>
+{
+public:
+   void next(int const & value)
+   {
+      this->observer->next(value + 1);
+   }
+
+   void nextBatch(int const * values, size_t count)
+   {
+      int mapped[64];
+      while ((count > 0) && !isUnsubscribed())
+      {
+         size_t n = (count < 64) ? count : 64;
+         for (size_t i = 0; i < n; i++) mapped[i] = values[i] + 1;
+         this->observer->nextBatch(mapped, n);
+         values += n;
+         count -= n;
+      }
+   }
+
+   void error(char const * const & err)
+   {
+      this->observer->error(err);
+   }
+
+   void complete()
+   {
+      this->observer->complete();
+   }
+};
+
+
+//the same, but value by value
+class IncrementValueObserver : public MappingObserver<int, char const *>
+{
+public:
+   void next(int const & value)
+   {
+      this->observer->next(value + 1);
+   }
+
+   void error(char const * const & err)
+   {
+      this->observer->error(err);
+   }
+
+   void complete()
+   {
+      this->observer->complete();
+   }
+};
+
+
+
+/* -- (Module) Global Variables ------------------------------------------- */
+static std::atomic<size_t> allocations(0); //number of heap allocations (so far)
+static std::atomic<size_t> allocatedBytes(0);
+static volatile int64_t sink; //results go here, so the compiler can't drop the work
+static int values[VALUES];
+
+
+/* -- Implementation ------------------------------------------------------ */
+
+#if defined(__GLIBC__)
+//count the heap allocations of the whole program: "malloc" & co. are interposed (operator new, the arena and the
+//subject - they all end up here). the actual work is done by the functions of glibc
+extern "C" void * __libc_malloc(size_t size);
+extern "C" void * __libc_calloc(size_t count, size_t size);
+extern "C" void * __libc_realloc(void * memory, size_t size);
+extern "C" void __libc_free(void * memory);
+
+extern "C" void * malloc(size_t size)
+{
+   allocations.fetch_add(1, std::memory_order_relaxed);
+   allocatedBytes.fetch_add(size, std::memory_order_relaxed);
+   return __libc_malloc(size);
+}
+
+extern "C" void * calloc(size_t count, size_t size)
+{
+   allocations.fetch_add(1, std::memory_order_relaxed);
+   allocatedBytes.fetch_add(count * size, std::memory_order_relaxed);
+   return __libc_calloc(count, size);
+}
+
+extern "C" void * realloc(void * memory, size_t size)
+{
+   allocations.fetch_add(1, std::memory_order_relaxed);
+   allocatedBytes.fetch_add(size, std::memory_order_relaxed);
+   return __libc_realloc(memory, size);
+}
+
+extern "C" void free(void * memory)
+{
+   __libc_free(memory);
+}
+#define COUNTS_ALLOCATIONS 1
+#else
+#define COUNTS_ALLOCATIONS 0 //(the allocations are reported as 0)
+#endif
+
+
+
+//run "function" (which handles "elements" elements per call) for at least MIN_TIME - REPEATS times.
+//returns the (best) time per element in ns
+template <typename F>
+static double measure(size_t elements, F const & function)
+{
+   typedef std::chrono::steady_clock Clock;
+   double best = 0;
+   for (int r = 0; r < REPEATS; r++)
+   {
+      size_t calls = 0;
+      Clock::time_point begin = Clock::now();
+      double elapsed;
+      do
+      {
+         for (int i = 0; i < 16; i++) function();
+         calls += 16;
+         elapsed = std::chrono::duration<double>(Clock::now() - begin).count();
+      } while (elapsed < MIN_TIME);
+      double ns = elapsed * 1e9 / ((double)calls * (double)elements);
+      if ((r == 0) || (ns < best)) best = ns;
+   }
+   return best;
+}
+
+static void report(char const * name, double ns)
+{
+   printf("  %-40s %10.3f ns/element %12.1f M elements/s\n", name, ns, 1e3 / ns);
+}
+
+static void reportOp(char const * name, double ns, size_t allocs)
+{
+   printf("  %-40s %10.1f ns/op %10zu allocations/op\n", name, ns, allocs);
+}
+
+//number of heap allocations done by "function" (which is called once)
+template <typename F>
+static size_t countAllocations(F const & function)
+{
+   size_t before = allocations.load();
+   function();
+   return allocations.load() - before;
+}
+
+
+
+static void benchEmission()
+{
+   printf("emission of %zu values:\n", VALUES);
+   ObservableArena arena;
+
+   report("raw loop", measure(VALUES, []()
+   {
+      int64_t s = 0;
+      for (size_t i = 0; i < VALUES; i++) s += values[i];
+      sink = s;
+   }));
+
+   report("raw loop (map, filter)", measure(VALUES, []()
+   {
+      int64_t s = 0;
+      for (size_t i = 0; i < VALUES; i++)
+      {
+         int value = values[i] * 3;
+         if ((value & 1) == 0) s += value;
+      }
+      sink = s;
+   }));
+
+   report("fused from -> map -> filter -> subscribe", measure(VALUES, []()
+   {
+      SumValueObserver observer;
+      fused::from(values, VALUES) | fused::map([](int value) { return value * 3; })
+                                  | fused::filter([](int value) { return (value & 1) == 0; })
+                                  | fused::subscribe(observer);
+      sink = observer.sum;
+   }));
+
+   report("from -> nextBatch", measure(VALUES, [&arena]()
+   {
+      SumObserver observer;
+      IntObservable::from(values, VALUES, &arena)->subscribe(observer);
+      arena.release();
+      sink = observer.sum;
+   }));
+
+   report("from -> next (value by value)", measure(VALUES, [&arena]()
+   {
+      SumValueObserver observer;
+      IntObservable::from(values, VALUES, &arena)->subscribe(observer);
+      arena.release();
+      sink = observer.sum;
+   }));
+   printf("\n");
+}
+
+
+
+//emit VALUES values through "depth" stages of type Op
+template <typename Op>
+static void runChain(ObservableArena & arena, size_t depth)
+{
+   SumObserver observer;
+   IntObservable * observable = IntObservable::from(values, VALUES, &arena);
+   for (size_t d = 0; d < depth; d++) observable = observable->map(*arena.make<Op>(), &arena);
+   observable->subscribe(observer);
+   arena.release();
+   sink = observer.sum;
+}
+
+template <typename Op>
+static void benchChain(char const * kind)
+{
+   static size_t const depths[] = { 0, 1, 2, 4, 8, 16 };
+   printf("chain depth (%s):\n", kind);
+   ObservableArena arena;
+   double base = 0;
+   for (size_t i = 0; i < sizeof(depths) / sizeof(depths[0]); i++)
+   {
+      size_t depth = depths[i];
+      double ns = measure(VALUES, [&arena, depth]() { runChain<Op>(arena, depth); });
+      if (depth == 0) base = ns;
+      char name[64];
+      snprintf(name, sizeof(name), "%zu map stage(s)", depth);
+      printf("  %-40s %10.3f ns/element %12.1f M elements/s", name, ns, 1e3 / ns);
+      if (depth > 0) printf(" %8.3f ns/element/stage", (ns - base) / (double)depth);
+      printf("\n");
+   }
+   printf("\n");
+}
+
+
+
+static void benchSubscription()
+{
+   printf("subscription:\n");
+   ObservableArena arena;
+   IncrementObserver increment;
+
+   auto ofSubscribe = [&arena]()
+   {
+      SumObserver observer;
+      IntObservable::of(1, &arena)->subscribe(observer);
+      arena.release();
+      sink = observer.sum;
+   };
+   ofSubscribe(); //warm up (the arena gets its memory, the trampoline its queue)
+   reportOp("of (arena) -> subscribe", measure(1, ofSubscribe), countAllocations(ofSubscribe));
+
+   auto mapSubscribe = [&arena]()
+   {
+      SumObserver observer;
+      IncrementObserver * op = arena.make<IncrementObserver>();
+      IntObservable::of(1, &arena)->map(*op, &arena)->subscribe(observer);
+      arena.release();
+      sink = observer.sum;
+   };
+   mapSubscribe();
+   reportOp("of -> map (arena) -> subscribe", measure(1, mapSubscribe), countAllocations(mapSubscribe));
+
+   auto unsubscribeEarly = [&arena]()
+   {
+      IdleObserver observer;
+      IntObservable::from(values, VALUES, &arena)->subscribe(observer)->unsubscribe();
+      arena.release();
+   };
+   unsubscribeEarly();
+   reportOp("from (arena) -> subscribe, unsubscribe", measure(1, unsubscribeEarly), countAllocations(unsubscribeEarly));
+
+   Subject<int, char const *> subject;
+   SumObserver observer;
+   auto subjectSubscribe = [&subject, &observer]()
+   {
+      subject.subscribe(observer)->unsubscribe();
+   };
+   subjectSubscribe();
+   reportOp("subject: subscribe, unsubscribe", measure(1, subjectSubscribe), countAllocations(subjectSubscribe));
+   printf("\n");
+}
+
+
+
+static void benchFanOut()
+{
+   static size_t const fanOuts[] = { 1, 4, 16, 64 };
+   static size_t const BATCH = 1024;
+   printf("fan-out of a subject (ns per delivered element):\n");
+   for (size_t i = 0; i < sizeof(fanOuts) / sizeof(fanOuts[0]); i++)
+   {
+      size_t n = fanOuts[i];
+      Subject<int, char const *> subject;
+      SumObserver * observers = new SumObserver[n];
+      for (size_t o = 0; o < n; o++) subject.subscribe(observers[o]);
+
+      char name[64];
+      snprintf(name, sizeof(name), "%zu observer(s), batches of %zu", n, BATCH);
+      report(name, measure(BATCH * n, [&subject]() { subject.nextBatch(values, BATCH); }));
+      snprintf(name, sizeof(name), "%zu observer(s), value by value", n);
+      report(name, measure(BATCH * n, [&subject]() { for (size_t v = 0; v < BATCH; v++) subject.next(values[v]); }));
+
+      subject.complete();
+      delete[] observers;
+   }
+   printf("\n");
+}
+
+
+
+static void benchAllocations()
+{
+   static size_t const DEPTH = 4;
+   printf("allocations per pipeline (from -> %zu maps -> subscribe):\n", DEPTH);
+   IncrementObserver increments[DEPTH];
+
+   auto build = [&increments](ObservableArena * arena)
+   {
+      SumObserver observer;
+      IntObservable * observable = IntObservable::from(values, 16, arena);
+      for (size_t d = 0; d < DEPTH; d++) observable = observable->map(increments[d], arena);
+      observable->subscribe(observer);
+      sink = observer.sum;
+   };
+
+   size_t before = allocatedBytes.load();
+   size_t count = countAllocations([&build]() { build(nullptr); }); //(leaks the pipeline - once)
+   printf("  %-40s %10zu allocations %10zu bytes\n", "heap", count, allocatedBytes.load() - before);
+
+   ObservableArena arena;
+   before = allocatedBytes.load();
+   count = countAllocations([&build, &arena]() { build(&arena); arena.release(); });
+   printf("  %-40s %10zu allocations %10zu bytes\n", "arena (first use)", count, allocatedBytes.load() - before);
+   before = allocatedBytes.load();
+   count = countAllocations([&build, &arena]() { build(&arena); arena.release(); });
+   printf("  %-40s %10zu allocations %10zu bytes\n", "arena (reused)", count, allocatedBytes.load() - before);
+
+   ColdObservable<int, char const *> const * cold = ColdObservable<int, char const *>::from(values, 16);
+   for (size_t d = 0; d < DEPTH; d++) cold = cold->map(IncrementObserver());
+   auto subscribeCold = [cold, &arena]()
+   {
+      SumObserver observer;
+      cold->subscribe(observer, arena);
+      arena.release();
+      sink = observer.sum;
+   };
+   before = allocatedBytes.load();
+   count = countAllocations(subscribeCold);
+   printf("  %-40s %10zu allocations %10zu bytes\n", "cold definition (reused arena)", count, allocatedBytes.load() - before);
+   printf("\n");
+}
+
+
+
+static void benchSink()
+{
+   printf("writing %zu values as lines of text to /dev/null:\n", VALUES);
+   std::ofstream stream("/dev/null");
+   report("ostream << value << endl", measure(VALUES, [&stream]()
+   {
+      for (size_t i = 0; i < VALUES; i++) stream << values[i] << std::endl;
+   }));
+
+   int fd = open("/dev/null", O_WRONLY | O_CLOEXEC);
+   ObservableArena arena;
+   WriteSink<int, char const *> sink(fd);
+   report("from -> WriteSink", measure(VALUES, [&arena, &sink]()
+   {
+      IntObservable::from(values, VALUES, &arena)->subscribe(sink);
+      arena.release();
+   }));
+   printf("  (%llu bytes written by %llu system calls)\n", (unsigned long long)sink.bytesWritten(),
+          (unsigned long long)sink.writeCalls());
+   close(fd);
+   printf("\n");
+}
+
+
+
+int main(int argc, char * argv[])
+{
+   (void)argc;
+   (void)argv;
+   for (size_t i = 0; i < VALUES; i++) values[i] = (int)(i & 0xFF) - 128;
+
+   benchEmission();
+   benchChain<IncrementObserver>("batches");
+   benchChain<IncrementValueObserver>("value by value");
+   benchSubscription();
+   benchFanOut();
+   benchAllocations();
+   benchSink();
+   if (!COUNTS_ALLOCATIONS) printf("(allocations are counted with glibc only)\n");
+   return 0;
+}
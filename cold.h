@@ -0,0 +1,202 @@
+//-----------------------------------------------------------------------------
+/*!
+   \file
+   \brief Cold observables: a pipeline definition, that can be subscribed again and again.
+
+   The observables of observable.h are "hot" and one-shot: "of", "from" and "throwError" emit to their first
+   subscriber only, and a "map" keeps its state in the one mapping observer it was given. So a pipeline has to
+   be constructed again for each subscriber.
+
+   A ColdObservable is just the definition of a pipeline. It is built once (e.g. at startup) and never changes.
+   Each "subscribe" constructs a fresh (hot) pipeline from it - in the arena, the subscriber passes. The mapping
+   observers are created per subscription as well, by an OperatorFactory (by default: a copy of a prototype).
+   So each subscription has its own state, and the definition may be subscribed by many threads at the same
+   time (as long as each of them uses an arena of its own).
+
+      static ColdObservable<int, char const *> * const pipeline =
+         ColdObservable<int, char const *>::from(values, count)->map(TakeObserver<int, char const *>(3));
+
+      ObservableArena arena; //e.g. one per thread
+      pipeline->subscribe(observer, arena);
+      arena.release(); //once the subscription is done. the arena's memory gets reused by the next one
+*/
+//-----------------------------------------------------------------------------
+#ifndef COLD_H
+#define COLD_H
+
+/* -- Includes ------------------------------------------------------------ */
+#include <stddef.h>
+#include "arena.h"
+#include "observable.h"
+
+
+/* -- Types --------------------------------------------------------------- */
+
+//creates the mapping observer of a "map" - for each subscription anew
+template <typename V, typename E>
+class OperatorFactory
+{
+public:
+   virtual ~OperatorFactory() { }
+   virtual MappingObserver<V,E> * create(ObservableArena & arena) const = 0;
+};
+
+
+//operator factory, that creates copies of a prototype
+template <typename V, typename E, typename Op>
+class PrototypeFactory : public OperatorFactory<V,E>
+{
+public:
+   explicit PrototypeFactory(Op const & prototype) : prototype(prototype) { }
+
+   MappingObserver<V,E> * create(ObservableArena & arena) const
+   {
+      return arena.make<Op>(prototype);
+   }
+
+private:
+   Op prototype;
+};
+
+
+
+template <typename V, typename E>
+class ColdObservable
+{
+public:
+   virtual ~ColdObservable() { }
+
+   //construct a (hot) pipeline according to this definition in the given arena
+   virtual Observable<V,E> * build(ObservableArena & arena) const = 0;
+
+   //subscribe to a fresh pipeline. everything the subscription needs, is placed in the arena
+   Subscription * subscribe(Observer<V,E> & observer, ObservableArena & arena) const
+   {
+      return build(arena)->subscribe(observer);
+   }
+
+
+   //factory functions. (the definitions are allocated with "new". they are meant to live as long as the program)
+   static ColdObservable * of(V value);
+   static ColdObservable * from(V const * values, size_t count);
+   static ColdObservable * throwError(E err);
+
+   //define a "map", that uses the given factory to create its mapping observer (the factory must outlive the definition)
+   ColdObservable * map(OperatorFactory<V,E> const & factory) const;
+
+   //define a "map", that uses a copy of the given mapping observer for each subscription
+   template <typename Op>
+   ColdObservable * map(Op const & prototype) const
+   {
+      OperatorFactory<V,E> const * factory = new PrototypeFactory<V,E,Op>(prototype);
+      return map(*factory);
+   }
+};
+
+
+
+//definition of an observable, that emits a single value
+template <typename V, typename E>
+class ColdOf : public ColdObservable<V,E>
+{
+public:
+   explicit ColdOf(V value) : value(value) { }
+
+   Observable<V,E> * build(ObservableArena & arena) const
+   {
+      return Observable<V,E>::of(value, &arena);
+   }
+
+private:
+   V value;
+};
+
+
+//definition of an observable, that emits a series of values
+template <typename V, typename E>
+class ColdFrom : public ColdObservable<V,E>
+{
+public:
+   ColdFrom(V const * values, size_t count)
+   {
+      this->values = values;
+      this->count = count;
+   }
+
+   Observable<V,E> * build(ObservableArena & arena) const
+   {
+      return Observable<V,E>::from(values, count, &arena);
+   }
+
+private:
+   V const * values;
+   size_t count;
+};
+
+
+//definition of an observable, that emits an error
+template <typename V, typename E>
+class ColdThrowError : public ColdObservable<V,E>
+{
+public:
+   explicit ColdThrowError(E err) : err(err) { }
+
+   Observable<V,E> * build(ObservableArena & arena) const
+   {
+      return Observable<V,E>::throwError(err, &arena);
+   }
+
+private:
+   E err;
+};
+
+
+//definition of a "map" of another definition
+template <typename V, typename E>
+class ColdMap : public ColdObservable<V,E>
+{
+public:
+   ColdMap(ColdObservable<V,E> const * source, OperatorFactory<V,E> const * factory)
+   {
+      this->source = source;
+      this->factory = factory;
+   }
+
+   Observable<V,E> * build(ObservableArena & arena) const
+   {
+      Observable<V,E> * upstream = source->build(arena);
+      return upstream->map(*factory->create(arena), &arena);
+   }
+
+private:
+   ColdObservable<V,E> const * source;
+   OperatorFactory<V,E> const * factory;
+};
+
+
+
+template <typename V, typename E>
+ColdObservable<V,E> * ColdObservable<V,E>::of(V value)
+{
+   return new ColdOf<V,E>(value);
+}
+
+template <typename V, typename E>
+ColdObservable<V,E> * ColdObservable<V,E>::from(V const * values, size_t count)
+{
+   return new ColdFrom<V,E>(values, count);
+}
+
+template <typename V, typename E>
+ColdObservable<V,E> * ColdObservable<V,E>::throwError(E err)
+{
+   return new ColdThrowError<V,E>(err);
+}
+
+template <typename V, typename E>
+ColdObservable<V,E> * ColdObservable<V,E>::map(OperatorFactory<V,E> const & factory) const
+{
+   return new ColdMap<V,E>(this, &factory);
+}
+
+#endif
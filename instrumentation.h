@@ -0,0 +1,369 @@
+//-----------------------------------------------------------------------------
+/*!
+   \file
+   \brief Per-stage instrumentation: counters and latency histograms of the "map" stages.
+
+   Which stage of a pipeline is the bottleneck? How many values does a stage get, how many does it forward (and
+   how many does it drop)? Compiled with OBSERVABLE_INSTRUMENTATION set to 1, each "map" stage (the mapping
+   observer of "map", as well as the function of "map<U>") is wrapped by two probes, once it gets subscribed:
+   one in front of the stage, that counts what the stage gets and measures the time it takes - and one behind it,
+   that counts what the stage forwards (and subtracts the time spent downstream).
+   So the latency of a stage is its own time - per call of "next" / "nextBatch".
+
+      g++ -DOBSERVABLE_INSTRUMENTATION=1 main.cpp
+
+      ...
+      instrumentation::forEachStage([](StageStats const & stage) { ... });
+      instrumentation::printStages(stdout);
+
+   The stages register themselves on subscription and unregister on destruction (e.g. "arena.release()").
+   Without OBSERVABLE_INSTRUMENTATION (the default), there are no probes - and no cost at all.
+
+   The counters are written by the thread, that emits through the stage - and may be read by any other thread.
+   The latency is kept in a log-linear ("HDR" like) histogram: values are exact up to 16 ns, above that each
+   power of two is divided into 16 sub-buckets (so a percentile is off by less than 6.25 %).
+*/
+//-----------------------------------------------------------------------------
+#ifndef INSTRUMENTATION_H
+#define INSTRUMENTATION_H
+
+/* -- Includes ------------------------------------------------------------ */
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <atomic>
+#include <chrono>
+#include <mutex>
+#include <string>
+#include <typeinfo>
+#if defined(__GNUC__)
+#include <cxxabi.h>
+#endif
+
+
+/* -- Defines ------------------------------------------------------------- */
+#ifndef OBSERVABLE_INSTRUMENTATION
+#define OBSERVABLE_INSTRUMENTATION 0
+#endif
+
+
+/* -- Types --------------------------------------------------------------- */
+
+//log-linear histogram of latencies (in ns)
+class LatencyHistogram
+{
+public:
+   static const unsigned SUB_BITS = 4;
+   static const uint64_t SUB_BUCKETS = 1 << SUB_BITS; //sub-buckets per power of two
+   static const unsigned MAX_BITS = 48; //values are clamped to 2^48 - 1 ns (~3 days)
+   static const size_t BUCKETS = (MAX_BITS - SUB_BITS + 1) * SUB_BUCKETS;
+
+   LatencyHistogram() : total(0), sum(0), maximum(0)
+   {
+      for (size_t i = 0; i < BUCKETS; i++) buckets[i].store(0, std::memory_order_relaxed);
+   }
+
+   void record(uint64_t ns)
+   {
+      buckets[indexOf(ns)].fetch_add(1, std::memory_order_relaxed);
+      total.fetch_add(1, std::memory_order_relaxed);
+      sum.fetch_add(ns, std::memory_order_relaxed);
+      if (ns > maximum.load(std::memory_order_relaxed)) maximum.store(ns, std::memory_order_relaxed);
+   }
+
+   uint64_t count() const
+   {
+      return total.load(std::memory_order_relaxed);
+   }
+
+   uint64_t max() const
+   {
+      return maximum.load(std::memory_order_relaxed);
+   }
+
+   double mean() const
+   {
+      uint64_t n = count();
+      return (n > 0) ? (double)sum.load(std::memory_order_relaxed) / (double)n : 0.0;
+   }
+
+   //the latency, "percent" % of the recorded latencies are below or equal to (the upper bound of its bucket)
+   uint64_t percentile(double percent) const
+   {
+      uint64_t n = count();
+      if (n == 0) return 0;
+      uint64_t rank = (uint64_t)((percent / 100.0) * (double)n + 0.5);
+      if (rank < 1) rank = 1;
+      if (rank > n) rank = n;
+      uint64_t seen = 0;
+      for (size_t i = 0; i < BUCKETS; i++)
+      {
+         seen += buckets[i].load(std::memory_order_relaxed);
+         if (seen >= rank)
+         {
+            uint64_t upper = lowerBoundOf(i + 1) - 1;
+            return (upper < max()) ? upper : max();
+         }
+      }
+      return max();
+   }
+
+private:
+   std::atomic<uint64_t> buckets[BUCKETS];
+   std::atomic<uint64_t> total;
+   std::atomic<uint64_t> sum;
+   std::atomic<uint64_t> maximum;
+
+   static size_t indexOf(uint64_t ns)
+   {
+      if (ns < SUB_BUCKETS) return (size_t)ns;
+      if (ns >= ((uint64_t)1 << MAX_BITS)) ns = ((uint64_t)1 << MAX_BITS) - 1;
+      unsigned exponent = 63 - __builtin_clzll(ns); //>= SUB_BITS
+      uint64_t sub = (ns >> (exponent - SUB_BITS)) & (SUB_BUCKETS - 1);
+      return (size_t)((exponent - SUB_BITS + 1) * SUB_BUCKETS + sub);
+   }
+
+   static uint64_t lowerBoundOf(size_t index)
+   {
+      if (index < SUB_BUCKETS) return index;
+      unsigned exponent = (unsigned)(index / SUB_BUCKETS) + SUB_BITS - 1;
+      uint64_t sub = index % SUB_BUCKETS;
+      return (SUB_BUCKETS + sub) << (exponent - SUB_BITS);
+   }
+};
+
+
+
+class StageStats;
+
+//a call of a stage ("next" / "nextBatch"), that is in progress on this thread
+struct StageFrame
+{
+   StageStats * stage;
+   uint64_t downstreamNs; //time spent downstream, within this call
+   StageFrame * outer; //the call of the stage upstream (or the same stage, if entered recursively)
+
+   static StageFrame * & current()
+   {
+      static thread_local StageFrame * frame = nullptr;
+      return frame;
+   }
+};
+
+
+
+//the counters of a stage
+class StageStats
+{
+public:
+   StageStats() : receivedValues(0), receivedBatches(0), forwardedValues(0), forwardedBatches(0),
+                  minBatch(0), maxBatch(0), errors(0), completes(0)
+   {
+      this->registered = false;
+      this->prev = nullptr;
+      this->nextStage = nullptr;
+   }
+
+   ~StageStats()
+   {
+      detach();
+   }
+
+   //(the name is the type of the mapping observer)
+   std::string const & name() const { return stageName; }
+
+   uint64_t received() const { return receivedValues.load(std::memory_order_relaxed); }
+   uint64_t batches() const { return receivedBatches.load(std::memory_order_relaxed); }
+   uint64_t forwarded() const { return forwardedValues.load(std::memory_order_relaxed); }
+   uint64_t forwardedBatchCount() const { return forwardedBatches.load(std::memory_order_relaxed); }
+   uint64_t errorCount() const { return errors.load(std::memory_order_relaxed); }
+   uint64_t completeCount() const { return completes.load(std::memory_order_relaxed); }
+
+   //values, the stage got but didn't forward (a filter). 0 for a stage, that forwards more than it gets
+   uint64_t dropped() const
+   {
+      uint64_t in = received();
+      uint64_t out = forwarded();
+      return (in > out) ? (in - out) : 0;
+   }
+
+   //sizes of the batches (calls of "next" count as batches of 1)
+   uint64_t smallestBatch() const { return minBatch.load(std::memory_order_relaxed); }
+   uint64_t largestBatch() const { return maxBatch.load(std::memory_order_relaxed); }
+   double meanBatch() const
+   {
+      uint64_t n = batches();
+      return (n > 0) ? (double)received() / (double)n : 0.0;
+   }
+
+   //time spent in the stage itself (without the stages downstream), per call
+   LatencyHistogram const & latency() const { return histogram; }
+
+
+   //-- used by the probes --
+
+   //register the stage (on subscription). "type" is the type of the stage
+   void attach(std::type_info const & type, char const * prefix = "");
+   void detach();
+
+   static uint64_t now()
+   {
+      return (uint64_t)std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+   }
+
+   //the stage gets "n" values. returns the start time, "leave" needs
+   uint64_t enter(size_t n, StageFrame & frame)
+   {
+      receivedValues.fetch_add(n, std::memory_order_relaxed);
+      uint64_t batchCount = receivedBatches.fetch_add(1, std::memory_order_relaxed);
+      if ((batchCount == 0) || (n < minBatch.load(std::memory_order_relaxed))) minBatch.store(n, std::memory_order_relaxed);
+      if (n > maxBatch.load(std::memory_order_relaxed)) maxBatch.store(n, std::memory_order_relaxed);
+      frame.stage = this;
+      frame.downstreamNs = 0;
+      frame.outer = StageFrame::current();
+      StageFrame::current() = &frame;
+      return now();
+   }
+
+   //the stage has handled the values, "enter" was called for
+   void leave(uint64_t start, StageFrame & frame)
+   {
+      uint64_t elapsed = now() - start;
+      StageFrame::current() = frame.outer;
+      histogram.record((elapsed > frame.downstreamNs) ? (elapsed - frame.downstreamNs) : 0);
+   }
+
+   //the stage forwards "n" values, which took "ns" (downstream).
+   //(a stage may forward on another thread, than it got the values - e.g. observeOn. then "ns" doesn't count)
+   void forward(size_t n, uint64_t ns)
+   {
+      forwardedValues.fetch_add(n, std::memory_order_relaxed);
+      forwardedBatches.fetch_add(1, std::memory_order_relaxed);
+      StageFrame * frame = StageFrame::current();
+      if ((frame != nullptr) && (frame->stage == this)) frame->downstreamNs += ns;
+   }
+
+   void error() { errors.fetch_add(1, std::memory_order_relaxed); }
+   void complete() { completes.fetch_add(1, std::memory_order_relaxed); }
+
+private:
+   std::string stageName;
+   std::atomic<uint64_t> receivedValues;
+   std::atomic<uint64_t> receivedBatches;
+   std::atomic<uint64_t> forwardedValues;
+   std::atomic<uint64_t> forwardedBatches;
+   std::atomic<uint64_t> minBatch;
+   std::atomic<uint64_t> maxBatch;
+   std::atomic<uint64_t> errors;
+   std::atomic<uint64_t> completes;
+   LatencyHistogram histogram;
+   bool registered;
+   StageStats * prev; //list of the registered stages
+   StageStats * nextStage;
+
+   friend struct StageRegistry;
+
+   //copying makes no sense (the stage is registered by address)
+   StageStats(StageStats const &);
+   StageStats & operator=(StageStats const &);
+};
+
+
+
+//the registered stages (in order of their subscription)
+struct StageRegistry
+{
+   std::mutex mutex;
+   StageStats * first;
+   StageStats * last;
+
+   StageRegistry()
+   {
+      this->first = nullptr;
+      this->last = nullptr;
+   }
+
+   static StageRegistry & instance()
+   {
+      static StageRegistry registry;
+      return registry;
+   }
+
+   static StageStats * following(StageStats * stage)
+   {
+      return stage->nextStage;
+   }
+};
+
+
+inline void StageStats::attach(std::type_info const & type, char const * prefix)
+{
+   StageRegistry & registry = StageRegistry::instance();
+   std::lock_guard<std::mutex> lock(registry.mutex);
+   if (registered) return;
+   stageName = prefix;
+#if defined(__GNUC__)
+   int status = 0;
+   char * demangled = abi::__cxa_demangle(type.name(), nullptr, nullptr, &status);
+   stageName += (demangled != nullptr) ? demangled : type.name();
+   free(demangled);
+#else
+   stageName += type.name();
+#endif
+   prev = registry.last;
+   nextStage = nullptr;
+   if (registry.last != nullptr) registry.last->nextStage = this;
+   else registry.first = this;
+   registry.last = this;
+   registered = true;
+}
+
+inline void StageStats::detach()
+{
+   StageRegistry & registry = StageRegistry::instance();
+   std::lock_guard<std::mutex> lock(registry.mutex);
+   if (!registered) return;
+   if (prev != nullptr) prev->nextStage = nextStage;
+   else registry.first = nextStage;
+   if (nextStage != nullptr) nextStage->prev = prev;
+   else registry.last = prev;
+   registered = false;
+}
+
+
+
+/* -- Functions ----------------------------------------------------------- */
+
+namespace instrumentation
+{
+
+//call "function" (void function(StageStats const &)) for each registered stage.
+//(a stage doesn't get unregistered, while "function" runs. so it must not release the arena of a stage)
+template <typename F>
+void forEachStage(F const & function)
+{
+   StageRegistry & registry = StageRegistry::instance();
+   std::lock_guard<std::mutex> lock(registry.mutex);
+   for (StageStats * stage = registry.first; stage != nullptr; stage = StageRegistry::following(stage)) function(*stage);
+}
+
+//print a table of all registered stages
+inline void printStages(FILE * file)
+{
+   fprintf(file, "%-32s %10s %10s %10s %8s %10s %10s %10s %10s\n",
+           "stage", "received", "forwarded", "dropped", "batch", "p50 ns", "p99 ns", "max ns", "calls");
+   forEachStage([file](StageStats const & stage)
+   {
+      LatencyHistogram const & latency = stage.latency();
+      fprintf(file, "%-32.32s %10llu %10llu %10llu %8.1f %10llu %10llu %10llu %10llu\n", stage.name().c_str(),
+              (unsigned long long)stage.received(), (unsigned long long)stage.forwarded(),
+              (unsigned long long)stage.dropped(), stage.meanBatch(),
+              (unsigned long long)latency.percentile(50), (unsigned long long)latency.percentile(99),
+              (unsigned long long)latency.max(), (unsigned long long)latency.count());
+   });
+}
+
+} //namespace instrumentation
+
+#endif
@@ -1,18 +1,7 @@
 //-----------------------------------------------------------------------------
 /*!
    \file
-   \brief A simple Observable implementation.
-
-   Let’s write our own Observable interface implementation to understand what’s going on under the hood when we work with RxJS.
-
-   An observable is just a function. This function takes in an observer as an argument, and returns a subscription object.
-
-   An observer is just an object with three methods: next which takes in a value, error which takes in an error message and
-   complete with has no arguments.
-
-   A subscription object represents a disposable resource, such as the execution of an Observable. This subscription has a
-   bunch of methods such as add and remove, but the most important one is unsubscribe which takes no argument and just disposes
-   the resource held by the subscription.
+   \brief Demo (and test cases) of the simple Observable implementation in observable.h.
 
    Nach: https://medium.com/@fknussel/a-simple-observable-implementation-c9c809c89c69
 */
@@ -20,8 +9,23 @@
 
 /* -- Includes ------------------------------------------------------------ */
 #include <stdint.h>
+#include <stdio.h>
+#include <iomanip>
 #include <iostream>
 #include <string>
+#include "observable.h"
+#include "cold.h"
+#include "pipeline.h"
+#include "numeric.h"
+#include "operators.h"
+#include "backpressure.h"
+#include "scheduler.h"
+#include "subject.h"
+#include "mappedfile.h"
+#include "splitter.h"
+#include "sink.h"
+#include "timewheel.h"
+#include "workstealing.h"
 
 
 /* -- Defines ------------------------------------------------------------- */
@@ -32,213 +36,107 @@ using std::string;
 
 /* -- Types --------------------------------------------------------------- */
 
-
-
-template <typename V, typename E>
-class Observer
+//a value type without default constructor (for the test case 'map to another type')
+struct Label
 {
-public:
-   virtual void next(V const & value) = 0;
-   virtual void error(E const & err) = 0;
-   virtual void complete() = 0;
+   explicit Label(int value) : text(std::to_string(value) + "!") { }
+   string text;
 };
 
 
-//this is an intermediate observer, that is used in combination with the map functionality!!!
-template <typename V, typename E>
-class MappingObserver : public Observer<V,E>
-{
-public:
-   Observer<V,E> * observer; //the actuall observer that wants to get notified
-};
-
 
+/* -- (Module) Global Variables ------------------------------------------- */
 
-class Subscription
-{
-public:
-   virtual void unsubscribe() = 0;
 
-};
+/* -- Implementation ------------------------------------------------------ */
 
 
 
-template <typename V, typename E>
-class Observable : private Subscription //in this exampel, the Observable also implements the Subscription object...
+//demo of an "Integer-Observer" (that takes integers and notifies an character-string in case of error)
+class IntObserver : public Observer<int, char const *>
 {
 private:
-   //typedef for a C++ pointer to a member function
-   //(that takes an pointer to an observer and returns an pointer to a subscription object)
-   typedef Subscription * (Observable::*SubscribeHandler)(Observer<V,E> * observer);
-
-
-   SubscribeHandler subscribeHandler;
-   MappingObserver<V,E> * mappingObserver;
-   Observable * mappingObservable;
-   V value;
-   V const * values;
-   size_t valuesCount;
-   E err;
-
-
-private:
-   //constructor is private - as it shall not be called directly.
-   //instead, a factory function like "from", "of" or "throwError" shall be used!
-   Observable()
-   {
-      this->subscribeHandler = nullptr;
-      this->mappingObservable = nullptr;
-      this->values = nullptr;
-      this->valuesCount = 0;
-      this->err = nullptr;
-   }
-
+   string id;
 
-   //this is the method that is called when someone subscribes to the observable that was constructed...
-   //...using the "of" method
-   Subscription * subscribeHandler_of(Observer<V,E> * observer)
+public:
+   IntObserver(string id)
    {
-      //call (the one and only) "next"
-      observer->next(value);
-      //finally complete
-      observer->complete();
-      //prevent further invocation, by setting the handler fuction to NULL (as the observable has completed now!)
-      subscribeHandler = nullptr;
-      //as Observable derives from Subscription it is very easy at this point to return an Subscription object
-      return this;
+      this->id = id;
    }
 
-
-   //this is the method that is called when someone subscribes to the observable that was constructed...
-   //...using the "from" method
-   Subscription * subscribeHandler_from(Observer<V,E> * observer)
+   void next(int const & value)
    {
-      //call one "next" after the other
-      for (size_t i = 0; i < valuesCount; i++) observer->next(values[i]);
-      //finally complete
-      observer->complete();
-      //prevent further invocation, by setting the handler fuction to NULL (as the observable has completed now!)
-      subscribeHandler = nullptr;
-      //as Observable derives from Subscription it is very easy at this point to return an Subscription object
-      return this;
+      cout << id << ": " << value << endl;
    }
 
-
-   //this is the method that is called when someone subscribes to the observable that was constructed...
-   //...using the "throwError" method
-   Subscription * subscribeHandler_throwError(Observer<V,E> * observer)
+   void error(char const * const & err)
    {
-      //call error
-      observer->error(err);
-      //finally complete
-      observer->complete();
-      //prevent further invocation, by setting the handler fuction to NULL (as the observable has completed now!)
-      subscribeHandler = nullptr;
-      //as Observable derives from Subscription it is very easy at this point to return an Subscription object
-      return this;
+      cout << id << ": " << err << endl;
    }
 
-
-   //this is the method that is called when someone subscribes to the observable that was constructed...
-   //... using the "map" method of another observable
-   Subscription * subscribeHandler_map(Observer<V,E> * observer)
+   void complete()
    {
-      mappingObserver->observer = observer;
-      return mappingObservable->subscribe(*mappingObserver);
-      //TBD return subscription object of the mapping-observable or of "this"???
+      cout << id << ": complete!" << endl;
    }
+};
 
 
 
-   //this method implements Subscription::unsubscribe
-   void unsubscribe()
-   {
-      //TBD!?
-      //clear all
-      this->values = nullptr;
-      this->valuesCount = 0;
-      this->err = nullptr;
-   }
-
+//demo of an "Integer-Observer", that unsubscribes as soon as it gets a value above a limit
+class IntLimitObserver : public Observer<int, char const *>
+{
+private:
+   string id;
+   int limit;
 
 public:
-
-   //factory function to construct a observable that emits a single value
-   static Observable * of(V value) //call by value
+   IntLimitObserver(string id, int limit)
    {
-      Observable * thiz = new Observable();
-      thiz->subscribeHandler = &Observable::subscribeHandler_of;
-      thiz->value = value; //store a copy the value
-      return thiz;
-   }
-
-   //factory function to construct a observable that emits a series of values
-   static Observable * from(V const * values, size_t count) //values is pointer to (array of) const V(s)
-   {
-      Observable * thiz = new Observable();
-      thiz->subscribeHandler = &Observable::subscribeHandler_from;
-      thiz->values = values; //store pointer to the values
-      thiz->valuesCount = count;
-      return thiz;
+      this->id = id;
+      this->limit = limit;
    }
 
-   //factory function to construct a observable that emits an error
-   static Observable * throwError(E err) //call by value
+   void next(int const & value)
    {
-      Observable * thiz = new Observable();
-      thiz->subscribeHandler = &Observable::subscribeHandler_throwError;
-      thiz->err = err; //make a copy
-      return thiz;
+      cout << id << ": " << value << endl;
+      if (value > limit)
+      {
+         cout << id << ": that's above " << limit << " - unsubscribe!" << endl;
+         this->subscription->unsubscribe(); //the subscription object was passed to "start"
+      }
    }
 
-
-   //create a new Observable, that emits the "next-values" of this stream transformed by the given transformation function
-   Observable * map(MappingObserver<V,E> & mappingObserver)
+   void error(char const * const & err)
    {
-      Observable * newobs = new Observable();
-      newobs->subscribeHandler = &Observable::subscribeHandler_map;
-      newobs->mappingObserver = &mappingObserver;
-      newobs->mappingObservable = this;
-      return newobs;
+      cout << id << ": " << err << endl;
    }
 
-
-   //this method is a wrapper to call the respective subscribe handler method, set at construction
-   Subscription * subscribe(Observer<V,E> & observer)
+   void complete()
    {
-      //if the observable hasn't completed yet...
-      if (this->subscribeHandler != nullptr)
-      {
-         //use c++ function-/method-pointer to...
-         return (this->*subscribeHandler)(&observer); //...call either subscribeHandler_of/.._from/.._throwError
-      }
-      //otherwise: the observable has already completed
-      //subscription has no further effect, than just returning an Subscription object
-      return this; //as Observable derives from Subscription it is very easy at this point to return an Subscription object
+      cout << id << ": complete!" << endl;
    }
-
 };
 
 
 
-
-/* -- (Module) Global Variables ------------------------------------------- */
-
-
-/* -- Implementation ------------------------------------------------------ */
-
-
-
-//demo of an "Integer-Observer" (that takes integers and notifies an character-string in case of error)
-class IntObserver : public Observer<int, char const *>
+//demo of an "Integer-Observer", that requests only a limited number of values at the beginning
+class IntDemandObserver : public Observer<int, char const *>
 {
 private:
    string id;
+   size_t demand;
 
 public:
-   IntObserver(string id)
+   IntDemandObserver(string id, size_t demand)
    {
       this->id = id;
+      this->demand = demand;
+   }
+
+   void start(Subscription * subscription)
+   {
+      this->subscription = subscription; //keep the subscription (to request more values later)...
+      subscription->request(demand); //...but request only "demand" values for now
    }
 
    void next(int const & value)
@@ -277,6 +175,24 @@ public:
       forward = !forward; //toggle
    }
 
+   void nextBatch(int const * values, size_t count)
+   {
+      int mapped[64]; //map the batch chunk-wise into this buffer...
+      while ((count > 0) && !isUnsubscribed())
+      {
+         size_t n = 0;
+         size_t chunk = (count < 64) ? count : 64;
+         for (size_t i = 0; i < chunk; i++)
+         {
+            if (forward) mapped[n++] = 2 * values[i]; //(same as in "next")
+            forward = !forward;
+         }
+         if (n > 0) this->observer->nextBatch(mapped, n); //...and forward it as a whole
+         values += chunk;
+         count -= chunk;
+      }
+   }
+
    void error(char const * const & err)
    {
       this->observer->error(err); //forward (unmodifed) error to subscriber
@@ -362,6 +278,465 @@ int main(int argc, char * argv[])
 
 
 
+   cout << "--------------- TEST CASE 'arena' ---------------" << endl;
+   cout << "Creating the Mapped-Series-Observable (as in test case 'map'), but this time in an arena." << endl;
+   ObservableArena arena;
+   IntMapObserver arenaMappingObserver;
+   mappedSeriesObservable = IntObservable::from(series, 7, &arena)->map(arenaMappingObserver, &arena);
+
+   cout << "Now I am going to subscribe to the Mapped-Series-Observable." << endl;
+   mySubscription = mappedSeriesObservable->subscribe(myIntObserver);
+
+   cout << "Releasing the arena destroys both observables at once." << endl;
+   arena.release();
+
+   cout << "Building and releasing the same pipeline another 1000 times, doesn't allocate any further memory." << endl;
+   for (int i = 0; i < 1000; i++)
+   {
+      IntObservable::from(series, 7, &arena)->map(arenaMappingObserver, &arena);
+      arena.release();
+   }
+   cout << "The arena still uses " << arena.blocks() << " memory block." << endl;
+   cout << endl;
+
+
+
+   cout << "--------------- TEST CASE 'cold' ---------------" << endl;
+   cout << "Defining the Mapped-Series-Observable (as in test case 'map') once, as a cold observable." << endl;
+   ColdObservable<int, char const *> * coldObservable = ColdObservable<int, char const *>::from(series, 7)->map(IntMapObserver());
+
+   cout << "Each subscription gets a fresh pipeline (and a fresh mapping observer) in the arena. So subscribing twice emits twice." << endl;
+   for (int i = 0; i < 2; i++)
+   {
+      mySubscription = coldObservable->subscribe(myIntObserver, arena);
+      arena.release();
+   }
+   cout << endl;
+
+
+
+   cout << "--------------- TEST CASE 'fused pipeline' ---------------" << endl;
+   cout << "Doing the same as in test case 'map', but with a pipeline that is glued together at compile time." << endl;
+   cout << "Filter and map stages are inlined into a single loop - there are no virtual calls in between." << endl;
+   bool forward = false;
+   fused::from(series, 7)
+      | fused::filter([&forward](int const &) { forward = !forward; return forward; }) //forward only every seconde value
+      | fused::map([](int const & value) { return 2 * value; }) //double value
+      | fused::subscribe(myIntObserver);
+   cout << endl;
+
+
+
+   cout << "--------------- TEST CASE 'unsubscribe' ---------------" << endl;
+   cout << "Creating the Mapped-Series-Observable (as in test case 'map')." << endl;
+   IntMapObserver anotherMappingObserver;
+   mappedSeriesObservable = IntObservable::from(series, 7)->map(anotherMappingObserver);
+
+   cout << "Now I am going to subscribe with an observer, that unsubscribes as soon as it gets a value above 5." << endl;
+   cout << "Unsubscribing is passed on to the Integer-Series-Observable, which stops emitting immediately." << endl;
+   IntLimitObserver myLimitObserver("LimitObs", 5);
+   mySubscription = mappedSeriesObservable->subscribe(myLimitObserver);
+   cout << endl;
+
+
+
+   cout << "--------------- TEST CASE 'backpressure' ---------------" << endl;
+   {
+      cout << "Subscribing to the Integer-Series-Observable with an observer, that requests only 3 values." << endl;
+      IntDemandObserver myDemandObserver("DemandObs", 3);
+      mySubscription = IntObservable::from(series, 7)->subscribe(myDemandObserver);
+      cout << "Requesting 2 more values." << endl;
+      mySubscription->request(2);
+      cout << "Requesting all the rest." << endl;
+      mySubscription->request(Subscription::UNBOUNDED);
+
+      cout << "A subject doesn't care about demand. So keep (only) the latest 2 values it emits, for an observer that requests 1 value." << endl;
+      Subject<int, char const *> subject;
+      BackpressureObserver<int, char const *> keepLatest(BackpressureObserver<int, char const *>::KeepLatest, 2, "Overflow!");
+      IntDemandObserver mySlowObserver("SlowObs", 1);
+      mySubscription = subject.map(keepLatest)->subscribe(mySlowObserver);
+      IntObservable::from(series, 7)->subscribe(subject);
+      cout << "Requesting all the rest." << endl;
+      mySubscription->request(Subscription::UNBOUNDED);
+   }
+   cout << endl;
+
+
+
+   cout << "--------------- TEST CASE 'map to another type' ---------------" << endl;
+   cout << "Map the values of the Integer-Series-Observable to doubles (halve them) - and back to integers (times 10)." << endl;
+   cout << "The lambdas are stored inline in the observables." << endl;
+   mySubscription = IntObservable::from(series, 7)
+      ->map<double>([](int const & value) { return value / 2.0; })
+      ->map<int>([](double const & value) { return (int)(value * 10); })
+      ->subscribe(myIntObserver);
+   cout << "Map them to labels (a type without default constructor, e.g. \"-2!\") - and back to the length of the label." << endl;
+   mySubscription = IntObservable::from(series, 7)
+      ->map<Label>([](int const & value) { return Label(value); })
+      ->map<int>([](Label const & label) { return (int)label.text.size(); })
+      ->subscribe(myIntObserver);
+   cout << endl;
+
+
+
+   cout << "--------------- TEST CASE 'mapped file' ---------------" << endl;
+   cout << "Writing the values of the Integer-Series to a file - and emitting them from the (memory-mapped) file." << endl;
+   FILE * file = fopen("series.bin", "wb");
+   if (file != nullptr)
+   {
+      fwrite(series, sizeof(int), 7, file);
+      fclose(file);
+   }
+   mySubscription = fromMappedFile<int, char const *>("series.bin", true)->subscribe(myIntObserver);
+   remove("series.bin");
+
+   cout << "A file, that doesn't exist, emits an error." << endl;
+   mySubscription = fromMappedFile<int, char const *>("no-such-file.bin")->subscribe(myIntObserver);
+   cout << endl;
+
+
+
+   cout << "--------------- TEST CASE 'lambda observer' ---------------" << endl;
+   cout << "Subscribing to the Integer-Series-Observable with lambdas, instead of an observer object." << endl;
+   IntObservable::from(series, 7)->subscribe(
+      [](int const & value) { cout << "Lambda: " << value << endl; },
+      [](char const * const & err) { cout << "Lambda: " << err << endl; },
+      []() { cout << "Lambda: complete!" << endl; });
+
+   cout << "The same, but with a fused pipeline. As the type of the observer is known, the lambdas get inlined." << endl;
+   int64_t lambdaSum = 0;
+   auto sumObserver = makeObserver<int, char const *>([&lambdaSum](int const & value) { lambdaSum += value; });
+   fused::from(series, 7) | fused::subscribe(sumObserver);
+   cout << "The sum is " << lambdaSum << "." << endl;
+   cout << endl;
+
+
+
+   cout << "--------------- TEST CASE 'concat' ---------------" << endl;
+   cout << "Concatenating a Single-Integer-Observable, the Integer-Series-Observable and another Single-Integer-Observable." << endl;
+   cout << "Each of them gets subscribed, after the previous one has completed (by means of the trampoline - not nested)." << endl;
+   mySubscription = IntObservable::of(0)->concat(*IntObservable::from(series, 7))->concat(*IntObservable::of(8))->subscribe(myIntObserver);
+   cout << endl;
+
+
+
+   cout << "--------------- TEST CASE 'split' ---------------" << endl;
+   cout << "Splitting a text, that arrives in two batches, into lines. The second line spans both batches." << endl;
+   typedef Observable<char, char const *> CharObservable;
+   static char const text1[] = "GET /index.html\nPOST /lo";
+   static char const text2[] = "gin\n\nGET /logout";
+   split(CharObservable::from(text1, sizeof(text1) - 1)->concat(*CharObservable::from(text2, sizeof(text2) - 1)))->subscribe(
+      [](std::string_view const & line) { cout << "Line: '" << line << "'" << endl; },
+      [](char const * const & err) { cout << "Line: " << err << endl; },
+      []() { cout << "Line: complete!" << endl; });
+   cout << endl;
+
+
+
+   cout << "--------------- TEST CASE 'sink' ---------------" << endl;
+   cout << "Writing the values of the Integer-Series-Observable to stdout by a buffered sink (instead of 'cout << endl')." << endl;
+   cout << "The values are formatted into a buffer, which is written once - on complete." << endl;
+   cout.flush(); //(the sink writes to the file descriptor directly)
+   WriteSink<int, char const *> stdoutSink(STDOUT_FILENO);
+   mySubscription = IntObservable::from(series, 7)->subscribe(stdoutSink);
+   cout << stdoutSink.bytesWritten() << " bytes have been written by " << stdoutSink.writeCalls() << " system call(s)." << endl;
+   cout << endl;
+
+
+
+   cout << "--------------- TEST CASE 'take' ---------------" << endl;
+   cout << "Taking the first 3 values of the Integer-Series-Observable." << endl;
+   cout << "Afterwards the Integer-Series-Observable gets unsubscribed, so it stops emitting." << endl;
+   TakeObserver<int, char const *> takeThree(3);
+   mySubscription = IntObservable::from(series, 7)->map(takeThree)->subscribe(myIntObserver);
+
+   cout << "Taking the values of the Integer-Series-Observable, as long as they are below 5." << endl;
+   auto belowFive = takeWhile<int, char const *>([](int const & value) { return value < 5; });
+   mySubscription = IntObservable::from(series, 7)->map(belowFive)->subscribe(myIntObserver);
+
+   cout << "Taking the first value of the Integer-Series-Observable, that is below -3." << endl;
+   auto firstBelowMinus3 = first<int, char const *>("There is no such value!", [](int const & value) { return value < -3; });
+   mySubscription = IntObservable::from(series, 7)->map(firstBelowMinus3)->subscribe(myIntObserver);
+
+   cout << "Taking the first value of the Integer-Series-Observable, that is above 7." << endl;
+   auto firstAbove7 = first<int, char const *>("There is no such value!", [](int const & value) { return value > 7; });
+   mySubscription = IntObservable::from(series, 7)->map(firstAbove7)->subscribe(myIntObserver);
+
+   cout << "Taking the first value of an Error-Observable: just the error (and complete) are passed on." << endl;
+   auto firstOfError = first<int, char const *>("There is no such value!", AnyValue<int>());
+   mySubscription = IntObservable::throwError("An error occured!")->map(firstOfError)->subscribe(myIntObserver);
+   cout << endl;
+
+
+
+   cout << "--------------- TEST CASE 'subject' ---------------" << endl;
+   {
+      cout << "Creating a Subject and subscribing two observers to it. The second one unsubscribes above 3." << endl;
+      Subject<int, char const *> subject;
+      IntObserver subjectObserver("SubjectObs");
+      IntLimitObserver subjectLimitObserver("SubjectLimitObs", 3);
+      subject.subscribe(subjectObserver);
+      subject.subscribe(subjectLimitObserver);
+
+      cout << "Now the subject gets subscribed to the Integer-Series-Observable. Both observers get the values." << endl;
+      IntObservable::from(series, 7)->subscribe(subject);
+
+      cout << "A late subscriber gets 'complete' right away." << endl;
+      mySubscription = subject.subscribe(myIntObserver);
+   }
+   cout << endl;
+
+
+
+   cout << "--------------- TEST CASE 'replay subject' ---------------" << endl;
+   {
+      cout << "Creating a ReplaySubject, that keeps the last 3 values, and subscribing it to the Integer-Series-Observable." << endl;
+      ReplaySubject<int, char const *> replaySubject(3);
+      IntObservable::from(series, 7)->subscribe(replaySubject);
+
+      cout << "A late subscriber gets the last 3 values and 'complete'." << endl;
+      mySubscription = replaySubject.subscribe(myIntObserver);
+
+      cout << "Creating a BehaviorSubject with initial value 0 and subscribing to it." << endl;
+      BehaviorSubject<int, char const *> behaviorSubject(0);
+      mySubscription = behaviorSubject.subscribe(myIntObserver);
+      cout << "Emitting 42." << endl;
+      behaviorSubject.next(42);
+      cout << "The latest value is " << behaviorSubject.value() << "." << endl;
+      mySubscription->unsubscribe();
+
+      cout << "A ReplaySubject (last 2 values) with a subscriber, that subscribes another one from within 'next' (on value 2)." << endl;
+      ReplaySubject<int, char const *> nestedSubject(2);
+      IntObserver nestedObserver("Nested");
+      Subscription * nestedSubscription = nullptr;
+      auto subscribingObserver = makeObserver<int, char const *>(
+         [&nestedSubject, &nestedObserver, &nestedSubscription](int const & value) {
+            cout << "Subscribing: " << value << endl;
+            if ((value == 2) && (nestedSubscription == nullptr)) nestedSubscription = nestedSubject.subscribe(nestedObserver);
+         },
+         [](char const * const & err) { cout << "Subscribing: " << err << endl; },
+         []() { cout << "Subscribing: complete!" << endl; });
+      mySubscription = nestedSubject.subscribe(subscribingObserver);
+      cout << "Emitting 1, 2 and 3." << endl;
+      nestedSubject.next(1);
+      nestedSubject.next(2);
+      nestedSubject.next(3);
+      mySubscription->unsubscribe();
+      nestedSubscription->unsubscribe();
+
+      cout << "A slow subscriber doesn't hold up new ones: another observer subscribes, while it is busy with a value." << endl;
+      ReplaySubject<int, char const *> slowSubject(2);
+      std::atomic<bool> busy(false);
+      std::atomic<bool> joined(false);
+      auto slowObserver = makeObserver<int, char const *>(
+         [&busy, &joined](int const & value) {
+            busy = true;
+            for (int wait = 0; (wait < 1000) && !joined; wait++) std::this_thread::sleep_for(std::chrono::milliseconds(1));
+            cout << "Slow: " << value << (joined ? " (another one has subscribed meanwhile)" : " (nobody could subscribe meanwhile)") << endl;
+         },
+         [](char const * const & err) { cout << "Slow: " << err << endl; },
+         []() { cout << "Slow: complete!" << endl; });
+      slowSubject.subscribe(slowObserver);
+      std::thread slowEmitter([&slowSubject]() { slowSubject.next(1); });
+      while (!busy) std::this_thread::sleep_for(std::chrono::milliseconds(1));
+      IntObserver joiningObserver("Joining");
+      mySubscription = slowSubject.subscribe(joiningObserver);
+      joined = true;
+      slowEmitter.join();
+   }
+   cout << endl;
+
+
+
+   cout << "--------------- TEST CASE 'observeOn' ---------------" << endl;
+   cout << "Creating a thread pool with 2 threads." << endl;
+   ThreadPool pool(2);
+   cout << "Map the Integer-Series-Observable to an observable, that notifies its observer by a thread of the pool." << endl;
+   ObserveOnObserver<int, char const *> onPool(pool);
+   IntObservable * onPoolObservable = IntObservable::from(series, 7)->map(onPool);
+
+   cout << "Now I am going to subscribe to that observable (and wait, until the observer has got 'complete')." << endl;
+   mySubscription = onPoolObservable->subscribe(myIntObserver);
+   while (!onPool.isTerminated()) std::this_thread::yield();
+
+   cout << "The same with 8 values, but a queue, that has room for 4 values only: the values are requested again, as they" << endl;
+   cout << "get delivered - and 'complete' has a slot of its own." << endl;
+   int octet[] = { 1, 2, 3, 4, 5, 6, 7, 8 };
+   ObserveOnObserver<int, char const *> onPoolSmall(pool, 4);
+   mySubscription = IntObservable::from(octet, 8)->map(onPoolSmall)->subscribe(myIntObserver);
+   while (!onPoolSmall.isTerminated()) std::this_thread::yield();
+
+   cout << "A Subject, whose values are delivered by a pool (one thread) to an observer, that unsubscribes above 3." << endl;
+   cout << "The delivering thread keeps using the subscription of the subject after the unsubscribe." << endl;
+   {
+      Subject<int, char const *> pooledSubject;
+      IntLimitObserver pooledLimitObserver("PooledLimitObs", 3);
+      ThreadPool * singlePool = new ThreadPool(1);
+      ObserveOnObserver<int, char const *> onSinglePool(*singlePool, 16);
+      mySubscription = pooledSubject.map(onSinglePool)->subscribe(pooledLimitObserver);
+      for (int i = 0; i < 7; i++) pooledSubject.next(series[i]);
+      pooledSubject.complete();
+      delete singlePool; //stops the pool (after it has run all its tasks) - before the observers and the subject go
+   }
+   cout << endl;
+
+
+
+   cout << "--------------- TEST CASE 'subscribeOn' ---------------" << endl;
+   {
+      cout << "Creating an executor with a dedicated thread." << endl;
+      ThreadExecutor executorThread;
+      cout << "Creating an Integer-Series-Observable, that emits its values by means of that executor." << endl;
+      IntObservable * backgroundObservable = IntObservable::from(series, 7)->subscribeOn(executorThread);
+
+      cout << "Now I am going to subscribe to that observable. The subscription returns immediately." << endl;
+      mySubscription = backgroundObservable->subscribe(myIntObserver);
+      //leaving the scope stops the executor (after it has run all its tasks)
+   }
+   cout << "The executor has been stopped." << endl;
+   {
+      cout << "The same with a work-stealing executor (two workers)." << endl;
+      WorkStealingExecutor workStealing(2);
+      IntObservable * stolenObservable = IntObservable::from(series, 7)->subscribeOn(workStealing);
+      mySubscription = stolenObservable->subscribe(myIntObserver);
+   }
+   cout << "The executor has been stopped." << endl;
+   {
+      cout << "A work-stealing executor (three workers), one of which gets blocked by a long running task." << endl;
+      WorkStealingExecutor workStealing(3);
+      struct Blocking
+      {
+         std::atomic<bool> running;
+         std::atomic<bool> released;
+         std::atomic<int> done;
+      } blocking;
+      blocking.running = false;
+      blocking.released = false;
+      blocking.done = 0;
+      workStealing.execute(Task{[](void * context) {
+         Blocking * blocking = (Blocking *)context;
+         blocking->running = true;
+         while (!blocking->released) std::this_thread::sleep_for(std::chrono::milliseconds(1));
+      }, &blocking});
+      while (!blocking.running) std::this_thread::sleep_for(std::chrono::milliseconds(1));
+
+      cout << "Submitting 9 tasks from outside. They are handed out round robin - also to the blocked worker." << endl;
+      for (int i = 0; i < 9; i++) workStealing.execute(Task{[](void * context) { ((Blocking *)context)->done++; }, &blocking});
+      for (int wait = 0; (wait < 5000) && (blocking.done < 9); wait++) std::this_thread::sleep_for(std::chrono::milliseconds(1));
+      cout << "Tasks run by the other workers, while the worker is blocked: " << blocking.done << " of 9" << endl;
+      blocking.released = true;
+   }
+   cout << "The executor has been stopped." << endl;
+   cout << endl;
+
+
+
+   cout << "--------------- TEST CASE 'time' ---------------" << endl;
+   {
+      cout << "Creating a scheduler, that runs timers (kept in a timing wheel) by a thread of its own." << endl;
+      WheelScheduler wheelScheduler;
+      std::atomic<bool> timeDone(false);
+      auto timeObserver = makeObserver<int, char const *>(
+         [](int const & value) { cout << "Time: " << value << endl; },
+         [](char const * const & err) { cout << "Time: " << err << endl; },
+         [&timeDone]() { cout << "Time: complete!" << endl; timeDone = true; });
+      auto waitForTime = [&timeDone]() { while (!timeDone.exchange(false)) std::this_thread::sleep_for(std::chrono::milliseconds(1)); };
+
+      cout << "Taking the first 3 values of an interval of 10 ms." << endl;
+      TakeObserver<int, char const *> takeTicks(3);
+      mySubscription = interval<int, char const *>(wheelScheduler, std::chrono::milliseconds(10))->map(takeTicks)->subscribe(timeObserver);
+      waitForTime();
+
+      cout << "A timer, that emits a single value after 5 ms." << endl;
+      mySubscription = timer<int, char const *>(wheelScheduler, std::chrono::milliseconds(5))->subscribe(timeObserver);
+      waitForTime();
+
+      cout << "Delaying the values of the Integer-Series-Observable by 20 ms." << endl;
+      DelayObserver<int, char const *> delayed(wheelScheduler, std::chrono::milliseconds(20));
+      mySubscription = IntObservable::from(series, 7)->map(delayed)->subscribe(timeObserver);
+      waitForTime();
+
+      cout << "A subject, that emits 2 values and then nothing - with a timeout of 20 ms." << endl;
+      Subject<int, char const *> quietSubject;
+      TimeoutObserver<int, char const *> timeout(wheelScheduler, std::chrono::milliseconds(20), "Timeout!");
+      mySubscription = quietSubject.map(timeout)->subscribe(timeObserver);
+      quietSubject.next(1);
+      quietSubject.next(2);
+      waitForTime();
+   }
+   cout << endl;
+
+
+
+   cout << "--------------- TEST CASE 'virtual time' ---------------" << endl;
+   {
+      cout << "Creating a scheduler with a virtual time, that passes only when it gets advanced (no sleeping)." << endl;
+      VirtualTimeScheduler virtualScheduler;
+      auto virtualObserver = makeObserver<int, char const *>(
+         [&virtualScheduler](int const & value) { cout << "Virtual: " << value << " at " << virtualScheduler.now() / 3600000000000LL << " h" << endl; },
+         [&virtualScheduler](char const * const & err) { cout << "Virtual: " << err << " at " << virtualScheduler.now() / 3600000000000LL << " h" << endl; },
+         []() { cout << "Virtual: complete!" << endl; });
+
+      cout << "Subscribing to an interval of 1 hour, that gets delayed by 2 hours, and advancing the time by 5 hours." << endl;
+      DelayObserver<int, char const *> delayedHours(virtualScheduler, std::chrono::hours(2));
+      mySubscription = interval<int, char const *>(virtualScheduler, std::chrono::hours(1))->map(delayedHours)->subscribe(virtualObserver);
+      virtualScheduler.advanceBy(std::chrono::hours(5));
+      mySubscription->unsubscribe();
+
+      cout << "A subject with a timeout of 3 hours, that emits a value at 6 h and then nothing. Advancing to 24 h." << endl;
+      Subject<int, char const *> virtualSubject;
+      TimeoutObserver<int, char const *> virtualTimeout(virtualScheduler, std::chrono::hours(3), "Timeout!");
+      mySubscription = virtualSubject.map(virtualTimeout)->subscribe(virtualObserver);
+      virtualScheduler.advanceTo(6 * 3600000000000LL);
+      virtualSubject.next(1);
+      virtualScheduler.advanceTo(24 * 3600000000000LL);
+
+      cout << "A subject delayed by 1 hour, that emits a value and an error at 24 h - and completes at 30 h." << endl;
+      cout << "The error isn't delayed (the value is dropped). The complete follows the error." << endl;
+      Subject<int, char const *> failingSubject;
+      DelayObserver<int, char const *> delayedFailure(virtualScheduler, std::chrono::hours(1));
+      mySubscription = failingSubject.map(delayedFailure)->subscribe(virtualObserver);
+      failingSubject.next(2);
+      failingSubject.error("Failed!");
+      virtualScheduler.advanceTo(30 * 3600000000000LL);
+      failingSubject.complete();
+   }
+   cout << endl;
+
+
+
+   cout << "--------------- TEST CASE 'numeric operators' ---------------" << endl;
+   cout << "Creating a Integer-Series-Observable, that emits a series of integer values before it completes." << endl;
+   intSeriesObservable = IntObservable::from(series, 7);
+
+   cout << "Scale each value by 3 and add 1, forward only the positive values and sum them up." << endl;
+   cout << "These operators work on whole batches (using SIMD instructions, if the CPU supports them)." << endl;
+   ScaleOffsetObserver<int, char const *> scaleOffset(3, 1);
+   CompareFilterObserver<int, char const *> positive(simd::Greater, 0);
+   ReduceObserver<int, char const *> sum(ReduceObserver<int, char const *>::Sum);
+   IntObservable * sumObservable = intSeriesObservable->map(scaleOffset)->map(positive)->map(sum);
+
+   cout << "Now I am going to subscribe to the Sum-Observable." << endl;
+   mySubscription = sumObservable->subscribe(myIntObserver);
+
+   cout << "Now I am going to unsubscribe from that Sum-Observable." << endl;
+   mySubscription->unsubscribe();
+
+   cout << "The sum and the mean are emitted as int: the sum of 2000000000, 2000000000 and 3 wraps around, the mean is truncated." << endl;
+   int bigValues[] = { 2000000000, 2000000000, 3 };
+   ReduceObserver<int, char const *> bigSum(ReduceObserver<int, char const *>::Sum);
+   ReduceObserver<int, char const *> bigMean(ReduceObserver<int, char const *>::Mean);
+   mySubscription = IntObservable::from(bigValues, 3)->map(bigSum)->subscribe(myIntObserver);
+   mySubscription = IntObservable::from(bigValues, 3)->map(bigMean)->subscribe(myIntObserver);
+   std::ios_base::fmtflags flags = cout.flags();
+   std::streamsize precision = cout.precision();
+   cout << "The exact ones: sum() = " << (long long)bigSum.sum() << ", mean() = " << std::fixed << std::setprecision(2) << bigMean.mean() << endl;
+   cout.flags(flags);
+   cout.precision(precision);
+   cout << endl;
+
+
+
    cout << "--------------- TEST CASE 'throwError' ---------------" << endl;
    cout << "Creating a Error-Observable, that emits an error text (c-string) before it completes." << endl;
    IntObservable * errorObservable = IntObservable::throwError("An error occured!");
@@ -379,6 +754,59 @@ int main(int argc, char * argv[])
 
 
 
+   cout << "--------------- TEST CASE 'instrumentation' ---------------" << endl;
+#if OBSERVABLE_INSTRUMENTATION
+   cout << "Subscribing to the Mapped-Series-Observable (as in test case 'map') in an arena." << endl;
+   cout << "Each stage counts what it gets and forwards - the mapping observer drops every second value." << endl;
+   ObservableArena statsArena;
+   IntMapObserver statsMapObserver;
+   IntObservable::from(series, 7, &statsArena)->map(statsMapObserver, &statsArena)->subscribe(myIntObserver);
+   StageStats const * mapStage = nullptr;
+   instrumentation::forEachStage([&mapStage](StageStats const & stage) { mapStage = &stage; }); //(the latest one)
+   cout << mapStage->name() << ": received " << mapStage->received() << ", forwarded " << mapStage->forwarded()
+        << ", dropped " << mapStage->dropped() << " in " << mapStage->batches() << " batch(es) - "
+        << "p50 latency " << mapStage->latency().percentile(50) << " ns" << endl;
+   cout << "All stages (so far):" << endl;
+   instrumentation::printStages(stdout);
+   statsArena.release(); //unregisters the stage
+#else
+   cout << "Compiled without instrumentation (there is no cost at all)." << endl;
+   cout << "Compile with -DOBSERVABLE_INSTRUMENTATION=1 to get the counters and latencies of each stage." << endl;
+#endif
+   cout << endl;
+
+
+
+   cout << "--------------- TEST CASE 'tracing' ---------------" << endl;
+#if OBSERVABLE_TRACING
+   cout << "All test cases so far have been traced: when each observable got subscribed (and unsubscribed) on which" << endl;
+   cout << "thread, and how long each batch took in each stage." << endl;
+   if (tracing::writeJson("trace.json")) cout << "The trace has been written to trace.json (open it in chrome://tracing)." << endl;
+   else cout << "The trace couldn't be written!" << endl;
+#else
+   cout << "Compiled without tracing (there is no cost at all)." << endl;
+   cout << "Compile with -DOBSERVABLE_TRACING=1 to get a trace of the subscriptions and batches (trace.json)." << endl;
+#endif
+   cout << endl;
+
+
+
+   cout << "--------------- TEST CASE 'sizes' ---------------" << endl;
+   cout << "Each kind of observable only stores what it needs. Their sizes (in bytes) are:" << endl;
+   IntObservable::Sizes sizes = IntObservable::sizes();
+   //(on 64 bit: the base takes 32 bytes. "of" and "from" add their values, the observer and one word of emission state)
+   static_assert((sizeof(void *) != 8) || (sizeof(ObservableOf<int, char const *>) <= 56), "'of' has grown");
+   static_assert((sizeof(void *) != 8) || (sizeof(ObservableFrom<int, char const *>) <= 64), "'from' has grown");
+   cout << " of: " << sizes.of << endl;
+   cout << " from: " << sizes.from << endl;
+   cout << " throwError: " << sizes.throwError << endl;
+   cout << " map: " << sizes.map << endl;
+   cout << " subscribeOn: " << sizes.subscribeOn << endl;
+   cout << " concat: " << sizes.concat << endl;
+   cout << endl;
+
+
+
    cout << endl << "---END---" << endl;
    return 0;
 }
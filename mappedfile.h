@@ -0,0 +1,171 @@
+//-----------------------------------------------------------------------------
+/*!
+   \file
+   \brief An observable, that emits the records of a memory-mapped file.
+
+   "from" emits the values of an array in memory. fromMappedFile does the same for a file of (trivially copyable)
+   records: the file is mapped into memory (mmap) and the records are emitted in batches directly from the mapping.
+   There is no read() and no copy - the observer gets pointers into the page cache. The kernel is told, that the
+   file is read sequentially (so it reads ahead), and - where supported - to use huge pages.
+
+   Replaying a file of many GB would make all of its pages resident, one after the other. With "releaseConsumed",
+   the pages that have been emitted are dropped again (madvise DONTNEED), so the resident memory stays bounded.
+   (therefore the values passed to "nextBatch" must not be used, after "nextBatch" has returned)
+
+      Observable<Tick, char const *> * ticks = fromMappedFile<Tick, char const *>("capture.bin", true);
+      ticks->subscribe(observer);
+
+   If the file can't be mapped, the observable emits an error (E constructed from the text of errno), followed
+   by complete - just like "throwError". A trailing partial record is ignored. POSIX only.
+*/
+//-----------------------------------------------------------------------------
+#ifndef MAPPEDFILE_H
+#define MAPPEDFILE_H
+
+/* -- Includes ------------------------------------------------------------ */
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <type_traits>
+#include "arena.h"
+#include "observable.h"
+
+
+/* -- Types --------------------------------------------------------------- */
+
+//observable constructed using "fromMappedFile".
+//it emits the values like "from" does (see ObservableArray) - just from the mapping
+template <typename V, typename E>
+class ObservableMappedFile : public ObservableArray<V,E>
+{
+   static_assert(std::is_trivially_copyable<V>::value, "the records of a mapped file must be trivially copyable");
+
+public:
+   //map the file and create the observable - either on the heap or (if given) in the arena
+   static ObservableMappedFile * open(char const * path, bool releaseConsumed, ObservableArena * arena)
+   {
+      ObservableMappedFile * thiz = (arena == nullptr) ? new ObservableMappedFile() : arena->make<ObservableMappedFile>();
+      thiz->releaseConsumed = releaseConsumed;
+      thiz->map(path);
+      return thiz;
+   }
+
+private:
+   static const size_t RELEASE_SIZE = 1 << 20; //consumed pages are released in steps of (at least) this size
+
+   unsigned char * mapping;
+   size_t mappingSize;
+   size_t released; //number of bytes (from the start of the mapping) that have been released
+   bool releaseConsumed;
+   int errorNumber; //errno, if the file couldn't be mapped
+
+   friend class ObservableArena;
+
+   ObservableMappedFile()
+   {
+      this->subscribeHandler = static_cast<typename Observable<V,E>::SubscribeHandler>(&ObservableMappedFile::subscribeHandler_mappedFile);
+      this->mapping = nullptr;
+      this->mappingSize = 0;
+      this->released = 0;
+      this->releaseConsumed = false;
+      this->errorNumber = 0;
+   }
+
+   ~ObservableMappedFile()
+   {
+      unmap();
+   }
+
+   void map(char const * path)
+   {
+      int fd = ::open(path, O_RDONLY | O_CLOEXEC);
+      if (fd < 0)
+      {
+         errorNumber = errno;
+         return;
+      }
+      struct stat info;
+      if (fstat(fd, &info) != 0)
+      {
+         errorNumber = errno;
+         ::close(fd);
+         return;
+      }
+      size_t size = (size_t)info.st_size;
+      if (size >= sizeof(V)) //(an empty file can't be mapped - there is nothing to emit anyway)
+      {
+         void * address = mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+         if (address == MAP_FAILED) errorNumber = errno;
+         else
+         {
+            mapping = (unsigned char *)address;
+            mappingSize = size;
+            this->values = (V const *)address;
+            this->end = this->values + size / sizeof(V);
+            madvise(address, size, MADV_SEQUENTIAL); //just hints. failing is fine
+#ifdef MADV_HUGEPAGE
+            madvise(address, size, MADV_HUGEPAGE);
+#endif
+         }
+      }
+      ::close(fd); //the mapping stays valid
+   }
+
+   void unmap()
+   {
+      if (mapping != nullptr) munmap(mapping, mappingSize);
+      mapping = nullptr;
+      mappingSize = 0;
+      this->values = nullptr;
+      this->end = nullptr;
+   }
+
+   //all values have been emitted (or the observer has unsubscribed)
+   void clear()
+   {
+      unmap();
+   }
+
+   //drop the pages of the values, that have been emitted
+   void emitted()
+   {
+      if (!releaseConsumed) return;
+      static size_t const pageSize = (size_t)sysconf(_SC_PAGESIZE);
+      size_t consumed = (((unsigned char const *)this->values - mapping) / pageSize) * pageSize; //whole pages only
+      if ((consumed - released) < RELEASE_SIZE) return;
+      madvise(mapping + released, consumed - released, MADV_DONTNEED);
+      released = consumed;
+   }
+
+   //this is the method that is called when someone subscribes to the observable that was constructed...
+   //...using "fromMappedFile"
+   Subscription * subscribeHandler_mappedFile(Observer<V,E> * observer)
+   {
+      if (errorNumber == 0) return this->subscribeHandler_array(observer); //emit the values of the mapping
+      //the file couldn't be mapped
+      this->subscribeHandler = nullptr;
+      observer->start(this);
+      if (!this->isClosed()) observer->error(E(strerror(errorNumber)));
+      if (!this->isClosed()) observer->complete();
+      return this;
+   }
+};
+
+
+
+/* -- Factory functions --------------------------------------------------- */
+
+//construct an observable, that emits the records (of type V) of the given file. if "releaseConsumed" is set,
+//the pages of the emitted records are released (to keep the resident memory bounded)
+template <typename V, typename E>
+Observable<V,E> * fromMappedFile(char const * path, bool releaseConsumed = false, ObservableArena * arena = nullptr)
+{
+   return ObservableMappedFile<V,E>::open(path, releaseConsumed, arena);
+}
+
+#endif
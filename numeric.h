@@ -0,0 +1,909 @@
+//-----------------------------------------------------------------------------
+/*!
+   \file
+   \brief Vectorized (SIMD) operators for int and float streams.
+
+   An observable created by "from" passes its values as one batch to the observer's "nextBatch" method.
+   The mapping observers in here take advantage of that: they work on whole chunks of values using SIMD
+   instructions, instead of handling one value after the other:
+
+   - ScaleOffsetObserver: maps each value to "value * scale + offset"
+   - CompareFilterObserver: forwards only the values that compare (<, <=, >, >=, ==, !=) to a threshold.
+     The remaining values are "compacted" into a contiguous buffer which is forwarded as one batch.
+   - ReduceObserver: sums up the values (or takes min/max/mean) and emits the result on completion
+
+   The instruction set is chosen at runtime (scalar, SSE4.2 or AVX2), depending on what the CPU supports.
+   So there is no need for special compiler flags (like -mavx2).
+*/
+//-----------------------------------------------------------------------------
+#ifndef NUMERIC_H
+#define NUMERIC_H
+
+/* -- Includes ------------------------------------------------------------ */
+#include <stddef.h>
+#include <stdint.h>
+#include <atomic>
+#include "observable.h"
+
+#if (defined(__x86_64__) || defined(__i386__)) && defined(__GNUC__)
+#define SIMD_X86 1
+#include <immintrin.h>
+#else
+#define SIMD_X86 0
+#endif
+
+
+/* -- Types --------------------------------------------------------------- */
+
+namespace simd
+{
+
+//instruction sets, the kernels are available for
+enum Level
+{
+   Scalar = 0,
+   SSE42 = 1,
+   AVX2 = 2
+};
+
+//comparisons, the filter kernel is able to do (value <cmp> threshold)
+enum Compare
+{
+   Less,
+   LessEqual,
+   Greater,
+   GreaterEqual,
+   Equal,
+   NotEqual
+};
+
+
+//the best instruction set the CPU supports
+inline Level detect()
+{
+#if SIMD_X86
+   __builtin_cpu_init();
+   if (__builtin_cpu_supports("avx2")) return AVX2;
+   if (__builtin_cpu_supports("sse4.2")) return SSE42;
+#endif
+   return Scalar;
+}
+
+//(atomic, as "setLevel" may be called, while other threads run the kernels)
+inline std::atomic<Level> & currentLevel()
+{
+   static std::atomic<Level> level(detect());
+   return level;
+}
+
+//the instruction set, the kernels are currently dispatched to
+inline Level level()
+{
+   return currentLevel().load(std::memory_order_relaxed);
+}
+
+//force the kernels to a lower instruction set (e.g. for comparison or benchmarking).
+//a level that isn't supported by the CPU is lowered to the best supported one.
+inline void setLevel(Level level)
+{
+   Level best = detect();
+   currentLevel().store((level > best) ? best : level, std::memory_order_relaxed);
+}
+
+inline char const * levelName(Level level)
+{
+   switch (level)
+   {
+   case AVX2: return "AVX2";
+   case SSE42: return "SSE4.2";
+   default: return "scalar";
+   }
+}
+
+
+
+//-- scalar kernels (reference implementation and handling of the "tail" of the vectorized ones) --
+namespace scalar
+{
+   //int arithmetic is done unsigned, to get the same (wrap-around) behaviour as the vector instructions
+   inline void scaleOffset(int const * in, int * out, size_t count, int scale, int offset)
+   {
+      for (size_t i = 0; i < count; i++) out[i] = (int)((unsigned)in[i] * (unsigned)scale + (unsigned)offset);
+   }
+
+   inline void scaleOffset(float const * in, float * out, size_t count, float scale, float offset)
+   {
+      for (size_t i = 0; i < count; i++) out[i] = in[i] * scale + offset;
+   }
+
+   template <typename V>
+   inline bool compare(V value, Compare cmp, V threshold)
+   {
+      switch (cmp)
+      {
+      case Less: return value < threshold;
+      case LessEqual: return value <= threshold;
+      case Greater: return value > threshold;
+      case GreaterEqual: return value >= threshold;
+      case Equal: return value == threshold;
+      default: return value != threshold;
+      }
+   }
+
+   //copies the values that pass the comparison to "out". returns the number of copied values.
+   //"out" may be the same as "in"
+   template <typename V>
+   inline size_t filter(V const * in, V * out, size_t count, Compare cmp, V threshold)
+   {
+      size_t n = 0;
+      for (size_t i = 0; i < count; i++)
+      {
+         if (compare(in[i], cmp, threshold)) out[n++] = in[i];
+      }
+      return n;
+   }
+
+   inline int64_t sum(int const * values, size_t count)
+   {
+      int64_t s = 0;
+      for (size_t i = 0; i < count; i++) s += values[i];
+      return s;
+   }
+
+   inline double sum(float const * values, size_t count)
+   {
+      double s = 0;
+      for (size_t i = 0; i < count; i++) s += values[i];
+      return s;
+   }
+
+   //min and max require count > 0
+   template <typename V>
+   inline V min(V const * values, size_t count)
+   {
+      V m = values[0];
+      for (size_t i = 1; i < count; i++) if (values[i] < m) m = values[i];
+      return m;
+   }
+
+   template <typename V>
+   inline V max(V const * values, size_t count)
+   {
+      V m = values[0];
+      for (size_t i = 1; i < count; i++) if (values[i] > m) m = values[i];
+      return m;
+   }
+}
+
+
+
+#if SIMD_X86
+
+//-- SSE4.2 kernels (4 lanes) --
+namespace sse42
+{
+   //shuffle control bytes that move the selected 32-bit lanes (bit set in mask) to the front
+   inline __m128i const * compactTable()
+   {
+      static struct Table
+      {
+         __m128i entry[16];
+         Table()
+         {
+            for (int mask = 0; mask < 16; mask++)
+            {
+               int8_t bytes[16];
+               int n = 0;
+               for (int lane = 0; lane < 4; lane++)
+               {
+                  if (mask & (1 << lane))
+                  {
+                     for (int b = 0; b < 4; b++) bytes[4 * n + b] = (int8_t)(4 * lane + b);
+                     n++;
+                  }
+               }
+               for (int b = 4 * n; b < 16; b++) bytes[b] = (int8_t)0x80; //zero the unused lanes
+               entry[mask] = _mm_setr_epi8(bytes[0], bytes[1], bytes[2], bytes[3], bytes[4], bytes[5], bytes[6], bytes[7],
+                                           bytes[8], bytes[9], bytes[10], bytes[11], bytes[12], bytes[13], bytes[14], bytes[15]);
+            }
+         }
+      } table;
+      return table.entry;
+   }
+
+   __attribute__((target("sse4.2")))
+   inline void scaleOffset(int const * in, int * out, size_t count, int scale, int offset)
+   {
+      __m128i s = _mm_set1_epi32(scale);
+      __m128i o = _mm_set1_epi32(offset);
+      size_t i = 0;
+      for (; i + 4 <= count; i += 4)
+      {
+         __m128i v = _mm_loadu_si128((__m128i const *)(in + i));
+         _mm_storeu_si128((__m128i *)(out + i), _mm_add_epi32(_mm_mullo_epi32(v, s), o));
+      }
+      scalar::scaleOffset(in + i, out + i, count - i, scale, offset);
+   }
+
+   __attribute__((target("sse4.2")))
+   inline void scaleOffset(float const * in, float * out, size_t count, float scale, float offset)
+   {
+      __m128 s = _mm_set1_ps(scale);
+      __m128 o = _mm_set1_ps(offset);
+      size_t i = 0;
+      for (; i + 4 <= count; i += 4)
+      {
+         _mm_storeu_ps(out + i, _mm_add_ps(_mm_mul_ps(_mm_loadu_ps(in + i), s), o));
+      }
+      scalar::scaleOffset(in + i, out + i, count - i, scale, offset);
+   }
+
+   template <Compare C>
+   __attribute__((target("sse4.2")))
+   inline __m128i mask(__m128i v, __m128i t)
+   {
+      __m128i ones = _mm_set1_epi32(-1);
+      switch (C)
+      {
+      case Less: return _mm_cmplt_epi32(v, t);
+      case LessEqual: return _mm_xor_si128(_mm_cmpgt_epi32(v, t), ones);
+      case Greater: return _mm_cmpgt_epi32(v, t);
+      case GreaterEqual: return _mm_xor_si128(_mm_cmplt_epi32(v, t), ones);
+      case Equal: return _mm_cmpeq_epi32(v, t);
+      default: return _mm_xor_si128(_mm_cmpeq_epi32(v, t), ones);
+      }
+   }
+
+   template <Compare C>
+   __attribute__((target("sse4.2")))
+   inline __m128 mask(__m128 v, __m128 t)
+   {
+      switch (C)
+      {
+      case Less: return _mm_cmplt_ps(v, t);
+      case LessEqual: return _mm_cmple_ps(v, t);
+      case Greater: return _mm_cmpgt_ps(v, t);
+      case GreaterEqual: return _mm_cmpge_ps(v, t);
+      case Equal: return _mm_cmpeq_ps(v, t);
+      default: return _mm_cmpneq_ps(v, t);
+      }
+   }
+
+   template <Compare C>
+   __attribute__((target("sse4.2")))
+   inline size_t filter(int const * in, int * out, size_t count, int threshold)
+   {
+      __m128i const * table = compactTable();
+      __m128i t = _mm_set1_epi32(threshold);
+      size_t n = 0;
+      size_t i = 0;
+      for (; i + 4 <= count; i += 4)
+      {
+         __m128i v = _mm_loadu_si128((__m128i const *)(in + i));
+         int m = _mm_movemask_ps(_mm_castsi128_ps(mask<C>(v, t)));
+         //always stores 4 lanes. that's fine, as n <= i (even if "out" is the same as "in")
+         _mm_storeu_si128((__m128i *)(out + n), _mm_shuffle_epi8(v, table[m]));
+         n += __builtin_popcount(m);
+      }
+      return n + scalar::filter(in + i, out + n, count - i, C, threshold);
+   }
+
+   template <Compare C>
+   __attribute__((target("sse4.2")))
+   inline size_t filter(float const * in, float * out, size_t count, float threshold)
+   {
+      __m128i const * table = compactTable();
+      __m128 t = _mm_set1_ps(threshold);
+      size_t n = 0;
+      size_t i = 0;
+      for (; i + 4 <= count; i += 4)
+      {
+         __m128 v = _mm_loadu_ps(in + i);
+         int m = _mm_movemask_ps(mask<C>(v, t));
+         _mm_storeu_si128((__m128i *)(out + n), _mm_shuffle_epi8(_mm_castps_si128(v), table[m]));
+         n += __builtin_popcount(m);
+      }
+      return n + scalar::filter(in + i, out + n, count - i, C, threshold);
+   }
+
+   __attribute__((target("sse4.2")))
+   inline int64_t sum(int const * values, size_t count)
+   {
+      __m128i acc = _mm_setzero_si128(); //2 x int64
+      size_t i = 0;
+      for (; i + 4 <= count; i += 4)
+      {
+         __m128i v = _mm_loadu_si128((__m128i const *)(values + i));
+         acc = _mm_add_epi64(acc, _mm_cvtepi32_epi64(v));
+         acc = _mm_add_epi64(acc, _mm_cvtepi32_epi64(_mm_unpackhi_epi64(v, v)));
+      }
+      int64_t lanes[2];
+      _mm_storeu_si128((__m128i *)lanes, acc);
+      return lanes[0] + lanes[1] + scalar::sum(values + i, count - i);
+   }
+
+   __attribute__((target("sse4.2")))
+   inline double sum(float const * values, size_t count)
+   {
+      __m128d acc = _mm_setzero_pd(); //2 x double
+      size_t i = 0;
+      for (; i + 4 <= count; i += 4)
+      {
+         __m128 v = _mm_loadu_ps(values + i);
+         acc = _mm_add_pd(acc, _mm_cvtps_pd(v));
+         acc = _mm_add_pd(acc, _mm_cvtps_pd(_mm_movehl_ps(v, v)));
+      }
+      double lanes[2];
+      _mm_storeu_pd(lanes, acc);
+      return lanes[0] + lanes[1] + scalar::sum(values + i, count - i);
+   }
+
+   __attribute__((target("sse4.2")))
+   inline int min(int const * values, size_t count)
+   {
+      if (count < 4) return scalar::min(values, count);
+      __m128i acc = _mm_loadu_si128((__m128i const *)values);
+      size_t i = 4;
+      for (; i + 4 <= count; i += 4) acc = _mm_min_epi32(acc, _mm_loadu_si128((__m128i const *)(values + i)));
+      int lanes[4];
+      _mm_storeu_si128((__m128i *)lanes, acc);
+      int m = scalar::min(lanes, 4);
+      for (; i < count; i++) if (values[i] < m) m = values[i];
+      return m;
+   }
+
+   __attribute__((target("sse4.2")))
+   inline int max(int const * values, size_t count)
+   {
+      if (count < 4) return scalar::max(values, count);
+      __m128i acc = _mm_loadu_si128((__m128i const *)values);
+      size_t i = 4;
+      for (; i + 4 <= count; i += 4) acc = _mm_max_epi32(acc, _mm_loadu_si128((__m128i const *)(values + i)));
+      int lanes[4];
+      _mm_storeu_si128((__m128i *)lanes, acc);
+      int m = scalar::max(lanes, 4);
+      for (; i < count; i++) if (values[i] > m) m = values[i];
+      return m;
+   }
+
+   __attribute__((target("sse4.2")))
+   inline float min(float const * values, size_t count)
+   {
+      if (count < 4) return scalar::min(values, count);
+      __m128 acc = _mm_loadu_ps(values);
+      size_t i = 4;
+      for (; i + 4 <= count; i += 4) acc = _mm_min_ps(acc, _mm_loadu_ps(values + i));
+      float lanes[4];
+      _mm_storeu_ps(lanes, acc);
+      float m = scalar::min(lanes, 4);
+      for (; i < count; i++) if (values[i] < m) m = values[i];
+      return m;
+   }
+
+   __attribute__((target("sse4.2")))
+   inline float max(float const * values, size_t count)
+   {
+      if (count < 4) return scalar::max(values, count);
+      __m128 acc = _mm_loadu_ps(values);
+      size_t i = 4;
+      for (; i + 4 <= count; i += 4) acc = _mm_max_ps(acc, _mm_loadu_ps(values + i));
+      float lanes[4];
+      _mm_storeu_ps(lanes, acc);
+      float m = scalar::max(lanes, 4);
+      for (; i < count; i++) if (values[i] > m) m = values[i];
+      return m;
+   }
+}
+
+
+
+//-- AVX2 kernels (8 lanes) --
+namespace avx2
+{
+   //permutation indices that move the selected 32-bit lanes (bit set in mask) to the front
+   inline int32_t const * compactTable()
+   {
+      static struct Table
+      {
+         alignas(32) int32_t entry[256][8];
+         Table()
+         {
+            for (int mask = 0; mask < 256; mask++)
+            {
+               int n = 0;
+               for (int lane = 0; lane < 8; lane++) if (mask & (1 << lane)) entry[mask][n++] = lane;
+               for (; n < 8; n++) entry[mask][n] = 0;
+            }
+         }
+      } table;
+      return &table.entry[0][0];
+   }
+
+   __attribute__((target("avx2")))
+   inline void scaleOffset(int const * in, int * out, size_t count, int scale, int offset)
+   {
+      __m256i s = _mm256_set1_epi32(scale);
+      __m256i o = _mm256_set1_epi32(offset);
+      size_t i = 0;
+      for (; i + 8 <= count; i += 8)
+      {
+         __m256i v = _mm256_loadu_si256((__m256i const *)(in + i));
+         _mm256_storeu_si256((__m256i *)(out + i), _mm256_add_epi32(_mm256_mullo_epi32(v, s), o));
+      }
+      scalar::scaleOffset(in + i, out + i, count - i, scale, offset);
+   }
+
+   __attribute__((target("avx2")))
+   inline void scaleOffset(float const * in, float * out, size_t count, float scale, float offset)
+   {
+      __m256 s = _mm256_set1_ps(scale);
+      __m256 o = _mm256_set1_ps(offset);
+      size_t i = 0;
+      for (; i + 8 <= count; i += 8)
+      {
+         //no FMA here, to get exactly the same results as the scalar code
+         _mm256_storeu_ps(out + i, _mm256_add_ps(_mm256_mul_ps(_mm256_loadu_ps(in + i), s), o));
+      }
+      scalar::scaleOffset(in + i, out + i, count - i, scale, offset);
+   }
+
+   template <Compare C>
+   __attribute__((target("avx2")))
+   inline __m256i mask(__m256i v, __m256i t)
+   {
+      __m256i ones = _mm256_set1_epi32(-1);
+      switch (C)
+      {
+      case Less: return _mm256_cmpgt_epi32(t, v);
+      case LessEqual: return _mm256_xor_si256(_mm256_cmpgt_epi32(v, t), ones);
+      case Greater: return _mm256_cmpgt_epi32(v, t);
+      case GreaterEqual: return _mm256_xor_si256(_mm256_cmpgt_epi32(t, v), ones);
+      case Equal: return _mm256_cmpeq_epi32(v, t);
+      default: return _mm256_xor_si256(_mm256_cmpeq_epi32(v, t), ones);
+      }
+   }
+
+   template <Compare C>
+   __attribute__((target("avx2")))
+   inline __m256 mask(__m256 v, __m256 t)
+   {
+      switch (C)
+      {
+      case Less: return _mm256_cmp_ps(v, t, _CMP_LT_OQ);
+      case LessEqual: return _mm256_cmp_ps(v, t, _CMP_LE_OQ);
+      case Greater: return _mm256_cmp_ps(v, t, _CMP_GT_OQ);
+      case GreaterEqual: return _mm256_cmp_ps(v, t, _CMP_GE_OQ);
+      case Equal: return _mm256_cmp_ps(v, t, _CMP_EQ_OQ);
+      default: return _mm256_cmp_ps(v, t, _CMP_NEQ_UQ);
+      }
+   }
+
+   template <Compare C>
+   __attribute__((target("avx2")))
+   inline size_t filter(int const * in, int * out, size_t count, int threshold)
+   {
+      int32_t const * table = compactTable();
+      __m256i t = _mm256_set1_epi32(threshold);
+      size_t n = 0;
+      size_t i = 0;
+      for (; i + 8 <= count; i += 8)
+      {
+         __m256i v = _mm256_loadu_si256((__m256i const *)(in + i));
+         int m = _mm256_movemask_ps(_mm256_castsi256_ps(mask<C>(v, t)));
+         __m256i idx = _mm256_load_si256((__m256i const *)(table + 8 * m));
+         //always stores 8 lanes. that's fine, as n <= i (even if "out" is the same as "in")
+         _mm256_storeu_si256((__m256i *)(out + n), _mm256_permutevar8x32_epi32(v, idx));
+         n += __builtin_popcount(m);
+      }
+      return n + scalar::filter(in + i, out + n, count - i, C, threshold);
+   }
+
+   template <Compare C>
+   __attribute__((target("avx2")))
+   inline size_t filter(float const * in, float * out, size_t count, float threshold)
+   {
+      int32_t const * table = compactTable();
+      __m256 t = _mm256_set1_ps(threshold);
+      size_t n = 0;
+      size_t i = 0;
+      for (; i + 8 <= count; i += 8)
+      {
+         __m256 v = _mm256_loadu_ps(in + i);
+         int m = _mm256_movemask_ps(mask<C>(v, t));
+         __m256i idx = _mm256_load_si256((__m256i const *)(table + 8 * m));
+         _mm256_storeu_ps(out + n, _mm256_permutevar8x32_ps(v, idx));
+         n += __builtin_popcount(m);
+      }
+      return n + scalar::filter(in + i, out + n, count - i, C, threshold);
+   }
+
+   __attribute__((target("avx2")))
+   inline int64_t sum(int const * values, size_t count)
+   {
+      __m256i acc = _mm256_setzero_si256(); //4 x int64
+      size_t i = 0;
+      for (; i + 8 <= count; i += 8)
+      {
+         __m256i v = _mm256_loadu_si256((__m256i const *)(values + i));
+         acc = _mm256_add_epi64(acc, _mm256_cvtepi32_epi64(_mm256_castsi256_si128(v)));
+         acc = _mm256_add_epi64(acc, _mm256_cvtepi32_epi64(_mm256_extracti128_si256(v, 1)));
+      }
+      int64_t lanes[4];
+      _mm256_storeu_si256((__m256i *)lanes, acc);
+      return lanes[0] + lanes[1] + lanes[2] + lanes[3] + scalar::sum(values + i, count - i);
+   }
+
+   __attribute__((target("avx2")))
+   inline double sum(float const * values, size_t count)
+   {
+      __m256d acc = _mm256_setzero_pd(); //4 x double
+      size_t i = 0;
+      for (; i + 8 <= count; i += 8)
+      {
+         __m256 v = _mm256_loadu_ps(values + i);
+         acc = _mm256_add_pd(acc, _mm256_cvtps_pd(_mm256_castps256_ps128(v)));
+         acc = _mm256_add_pd(acc, _mm256_cvtps_pd(_mm256_extractf128_ps(v, 1)));
+      }
+      double lanes[4];
+      _mm256_storeu_pd(lanes, acc);
+      return lanes[0] + lanes[1] + lanes[2] + lanes[3] + scalar::sum(values + i, count - i);
+   }
+
+   __attribute__((target("avx2")))
+   inline int min(int const * values, size_t count)
+   {
+      if (count < 8) return scalar::min(values, count);
+      __m256i acc = _mm256_loadu_si256((__m256i const *)values);
+      size_t i = 8;
+      for (; i + 8 <= count; i += 8) acc = _mm256_min_epi32(acc, _mm256_loadu_si256((__m256i const *)(values + i)));
+      int lanes[8];
+      _mm256_storeu_si256((__m256i *)lanes, acc);
+      int m = scalar::min(lanes, 8);
+      for (; i < count; i++) if (values[i] < m) m = values[i];
+      return m;
+   }
+
+   __attribute__((target("avx2")))
+   inline int max(int const * values, size_t count)
+   {
+      if (count < 8) return scalar::max(values, count);
+      __m256i acc = _mm256_loadu_si256((__m256i const *)values);
+      size_t i = 8;
+      for (; i + 8 <= count; i += 8) acc = _mm256_max_epi32(acc, _mm256_loadu_si256((__m256i const *)(values + i)));
+      int lanes[8];
+      _mm256_storeu_si256((__m256i *)lanes, acc);
+      int m = scalar::max(lanes, 8);
+      for (; i < count; i++) if (values[i] > m) m = values[i];
+      return m;
+   }
+
+   __attribute__((target("avx2")))
+   inline float min(float const * values, size_t count)
+   {
+      if (count < 8) return scalar::min(values, count);
+      __m256 acc = _mm256_loadu_ps(values);
+      size_t i = 8;
+      for (; i + 8 <= count; i += 8) acc = _mm256_min_ps(acc, _mm256_loadu_ps(values + i));
+      float lanes[8];
+      _mm256_storeu_ps(lanes, acc);
+      float m = scalar::min(lanes, 8);
+      for (; i < count; i++) if (values[i] < m) m = values[i];
+      return m;
+   }
+
+   __attribute__((target("avx2")))
+   inline float max(float const * values, size_t count)
+   {
+      if (count < 8) return scalar::max(values, count);
+      __m256 acc = _mm256_loadu_ps(values);
+      size_t i = 8;
+      for (; i + 8 <= count; i += 8) acc = _mm256_max_ps(acc, _mm256_loadu_ps(values + i));
+      float lanes[8];
+      _mm256_storeu_ps(lanes, acc);
+      float m = scalar::max(lanes, 8);
+      for (; i < count; i++) if (values[i] > m) m = values[i];
+      return m;
+   }
+}
+
+#endif //SIMD_X86
+
+
+
+//-- dispatching kernels. these are the ones to be used --
+
+//out[i] = in[i] * scale + offset. "out" may be the same as "in"
+template <typename V>
+inline void scaleOffset(V const * in, V * out, size_t count, V scale, V offset)
+{
+#if SIMD_X86
+   switch (level())
+   {
+   case AVX2: avx2::scaleOffset(in, out, count, scale, offset); return;
+   case SSE42: sse42::scaleOffset(in, out, count, scale, offset); return;
+   default: break;
+   }
+#endif
+   scalar::scaleOffset(in, out, count, scale, offset);
+}
+
+
+#if SIMD_X86
+template <Compare C, typename V>
+inline size_t filterVectorized(V const * in, V * out, size_t count, V threshold)
+{
+   if (level() == AVX2) return avx2::filter<C>(in, out, count, threshold);
+   return sse42::filter<C>(in, out, count, threshold);
+}
+#endif
+
+//copies the values "value <cmp> threshold" holds for, to "out" (the stream compaction).
+//returns the number of copied values. "out" must have room for "count" values and may be the same as "in".
+template <typename V>
+inline size_t filter(V const * in, V * out, size_t count, Compare cmp, V threshold)
+{
+#if SIMD_X86
+   if (level() != Scalar)
+   {
+      switch (cmp)
+      {
+      case Less: return filterVectorized<Less>(in, out, count, threshold);
+      case LessEqual: return filterVectorized<LessEqual>(in, out, count, threshold);
+      case Greater: return filterVectorized<Greater>(in, out, count, threshold);
+      case GreaterEqual: return filterVectorized<GreaterEqual>(in, out, count, threshold);
+      case Equal: return filterVectorized<Equal>(in, out, count, threshold);
+      default: return filterVectorized<NotEqual>(in, out, count, threshold);
+      }
+   }
+#endif
+   return scalar::filter(in, out, count, cmp, threshold);
+}
+
+
+//type of the sum of the values (wide enough to not overflow that fast)
+template <typename V> struct SumType;
+template <> struct SumType<int> { typedef int64_t Type; };
+template <> struct SumType<float> { typedef double Type; };
+
+template <typename V>
+inline typename SumType<V>::Type sum(V const * values, size_t count)
+{
+#if SIMD_X86
+   switch (level())
+   {
+   case AVX2: return avx2::sum(values, count);
+   case SSE42: return sse42::sum(values, count);
+   default: break;
+   }
+#endif
+   return scalar::sum(values, count);
+}
+
+//min and max require count > 0 (NaNs are not supported)
+template <typename V>
+inline V min(V const * values, size_t count)
+{
+#if SIMD_X86
+   switch (level())
+   {
+   case AVX2: return avx2::min(values, count);
+   case SSE42: return sse42::min(values, count);
+   default: break;
+   }
+#endif
+   return scalar::min(values, count);
+}
+
+template <typename V>
+inline V max(V const * values, size_t count)
+{
+#if SIMD_X86
+   switch (level())
+   {
+   case AVX2: return avx2::max(values, count);
+   case SSE42: return sse42::max(values, count);
+   default: break;
+   }
+#endif
+   return scalar::max(values, count);
+}
+
+} //namespace simd
+
+
+
+//mapping observer, that maps each value to "value * scale + offset" (V must be int or float)
+template <typename V, typename E>
+class ScaleOffsetObserver : public MappingObserver<V,E>
+{
+public:
+   ScaleOffsetObserver(V scale, V offset)
+   {
+      this->scale = scale;
+      this->offset = offset;
+   }
+
+   void next(V const & value)
+   {
+      V mapped;
+      simd::scalar::scaleOffset(&value, &mapped, 1, scale, offset);
+      this->observer->next(mapped);
+   }
+
+   void nextBatch(V const * values, size_t count)
+   {
+      V mapped[CHUNK];
+      while ((count > 0) && !this->isUnsubscribed())
+      {
+         size_t n = (count < CHUNK) ? count : CHUNK;
+         simd::scaleOffset(values, mapped, n, scale, offset);
+         this->observer->nextBatch(mapped, n);
+         values += n;
+         count -= n;
+      }
+   }
+
+   void error(E const & err)
+   {
+      this->observer->error(err);
+   }
+
+   void complete()
+   {
+      this->observer->complete();
+   }
+
+private:
+   static const size_t CHUNK = 256;
+   V scale;
+   V offset;
+};
+
+
+
+//mapping observer, that forwards only the values for which "value <cmp> threshold" holds (V must be int or float)
+template <typename V, typename E>
+class CompareFilterObserver : public MappingObserver<V,E>
+{
+public:
+   CompareFilterObserver(simd::Compare cmp, V threshold)
+   {
+      this->cmp = cmp;
+      this->threshold = threshold;
+   }
+
+   void next(V const & value)
+   {
+      if (simd::scalar::compare(value, cmp, threshold)) this->observer->next(value);
+      else this->dropped(1); //request a replacement
+   }
+
+   void nextBatch(V const * values, size_t count)
+   {
+      V passed[CHUNK];
+      while ((count > 0) && !this->isUnsubscribed())
+      {
+         size_t n = (count < CHUNK) ? count : CHUNK;
+         size_t m = simd::filter(values, passed, n, cmp, threshold);
+         if (m > 0) this->observer->nextBatch(passed, m);
+         this->dropped(n - m); //request replacements for the values filtered out
+         values += n;
+         count -= n;
+      }
+   }
+
+   void error(E const & err)
+   {
+      this->observer->error(err);
+   }
+
+   void complete()
+   {
+      this->observer->complete();
+   }
+
+private:
+   static const size_t CHUNK = 256;
+   simd::Compare cmp;
+   V threshold;
+};
+
+
+
+//mapping observer, that "reduces" all values to a single one, which is emitted on completion (V must be int or float).
+//if no value was received at all, it just completes.
+//the result is emitted as a V. so the sum of ints wraps around (like the int arithmetic of the kernels) and their
+//mean is truncated toward zero. the exact ones are readable via sum() (int64_t / double) and mean() - e.g. after
+//completion. only what the reduction needs is computed: sum() and mean() are valid for Sum and Mean, min() and
+//max() for Min and Max respectively. count() is valid always.
+template <typename V, typename E>
+class ReduceObserver : public MappingObserver<V,E>
+{
+public:
+   enum Reduction
+   {
+      Sum,
+      Min,
+      Max,
+      Mean
+   };
+
+   ReduceObserver(Reduction reduction)
+   {
+      this->reduction = reduction;
+      this->total = 0;
+      this->n = 0;
+      this->lowest = V();
+      this->highest = V();
+   }
+
+   void next(V const & value)
+   {
+      nextBatch(&value, 1);
+   }
+
+   //the result depends on all values. so all of them are requested - no matter, what the observer requests
+   void request(size_t)
+   {
+      MappingObserver<V,E>::request(Subscription::UNBOUNDED);
+   }
+
+   void nextBatch(V const * values, size_t count)
+   {
+      if (count == 0) return;
+      switch (reduction)
+      {
+      case Min:
+         {
+            V lo = simd::min(values, count);
+            if ((n == 0) || (lo < lowest)) lowest = lo;
+         }
+         break;
+      case Max:
+         {
+            V hi = simd::max(values, count);
+            if ((n == 0) || (hi > highest)) highest = hi;
+         }
+         break;
+      default: //Sum and Mean
+         total += simd::sum(values, count);
+         break;
+      }
+      n += count;
+   }
+
+   void error(E const & err)
+   {
+      this->observer->error(err);
+   }
+
+   void complete()
+   {
+      if (n > 0)
+      {
+         switch (reduction)
+         {
+         case Sum: this->observer->next((V)total); break;
+         case Min: this->observer->next(lowest); break;
+         case Max: this->observer->next(highest); break;
+         default: this->observer->next((V)mean()); break;
+         }
+      }
+      this->observer->complete();
+   }
+
+   typename simd::SumType<V>::Type sum() const { return total; }
+   V min() const { return lowest; }
+   V max() const { return highest; }
+   double mean() const { return (n > 0) ? (double)total / (double)n : 0.0; }
+   size_t count() const { return n; }
+
+private:
+   Reduction reduction;
+   typename simd::SumType<V>::Type total;
+   V lowest;
+   V highest;
+   size_t n;
+};
+
+#endif
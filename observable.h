@@ -0,0 +1,1468 @@
+//-----------------------------------------------------------------------------
+/*!
+   \file
+   \brief A simple Observable implementation.
+
+   Let’s write our own Observable interface implementation to understand what’s going on under the hood when we work with RxJS.
+
+   An observable is just a function. This function takes in an observer as an argument, and returns a subscription object.
+
+   An observer is just an object with three methods: next which takes in a value, error which takes in an error message and
+   complete with has no arguments.
+
+   A subscription object represents a disposable resource, such as the execution of an Observable. This subscription has a
+   bunch of methods such as add and remove, but the most important one is unsubscribe which takes no argument and just disposes
+   the resource held by the subscription.
+
+   Nach: https://medium.com/@fknussel/a-simple-observable-implementation-c9c809c89c69
+*/
+//-----------------------------------------------------------------------------
+#ifndef OBSERVABLE_H
+#define OBSERVABLE_H
+
+/* -- Includes ------------------------------------------------------------ */
+#include <stddef.h>
+#include <stdlib.h>
+#include <string.h>
+#include <atomic>
+#include <new>
+#include <type_traits>
+#include "arena.h"
+#include "instrumentation.h"
+#include "trace.h"
+
+
+/* -- Defines ------------------------------------------------------------- */
+//the "map" stages get wrapped by probes, if they are instrumented or traced
+#define OBSERVABLE_PROBES (OBSERVABLE_INSTRUMENTATION || OBSERVABLE_TRACING)
+
+
+/* -- Types --------------------------------------------------------------- */
+
+
+
+//a piece of work to be run by an executor. (a plain function pointer and its argument - no allocation needed)
+struct Task
+{
+   void (*run)(void * context);
+   void * context;
+};
+
+
+//an executor runs tasks - somewhere, sometime. (see scheduler.h for some implementations)
+class Executor
+{
+public:
+   virtual ~Executor() { }
+   virtual void execute(Task task) = 0;
+};
+
+
+//runs tasks on the calling thread - but never nested: a task that gets scheduled from within another task (on the
+//same thread), is queued and run after that one has returned. so recursion becomes a loop: subscribing along a
+//long chain of "map"s or "concat"s doesn't grow the stack with the length of the chain.
+//note: a synchronous source emits from within such a task. so subscribing to a "map" or "concat" from within
+//"next" (or "error" / "complete") is deferred as well: "subscribe" returns, before the source has started - it
+//starts, when the outermost task returns.
+//if a task throws, the exception is passed on to the caller of the outermost "schedule". the tasks queued so far
+//are dropped then (and the trampoline is ready to be used again)
+class Trampoline : public Executor
+{
+public:
+   void execute(Task task)
+   {
+      schedule(task);
+   }
+
+   static void schedule(Task task)
+   {
+      Queue & q = queue();
+      if (q.running)
+      {
+         q.push(task); //run by the loop below (further up the stack)
+         return;
+      }
+      q.running = true;
+      Reset reset(q);
+      task.run(task.context);
+      while (q.head < q.tail)
+      {
+         Task next = q.tasks[q.head++];
+         next.run(next.context);
+      }
+   }
+
+   //true, if the calling thread is running tasks of the trampoline right now
+   static bool isRunning()
+   {
+      return queue().running;
+   }
+
+private:
+   //the queue of each thread. (its memory is kept for reuse)
+   struct Queue
+   {
+      Task * tasks;
+      size_t head; //index of the next task to run
+      size_t tail; //index, where the next task gets queued
+      size_t capacity;
+      bool running;
+
+      Queue() : tasks(nullptr), head(0), tail(0), capacity(0), running(false) { }
+
+      ~Queue()
+      {
+         free(tasks);
+      }
+
+      void push(Task task)
+      {
+         if (tail == capacity)
+         {
+            if (head > 0) //move the pending tasks to the front
+            {
+               memmove(tasks, tasks + head, (tail - head) * sizeof(Task));
+               tail -= head;
+               head = 0;
+            }
+            else //grow
+            {
+               size_t size = (capacity > 0) ? (2 * capacity) : 64;
+               Task * grown = (Task *)realloc(tasks, size * sizeof(Task));
+               if (grown == nullptr) throw std::bad_alloc();
+               tasks = grown;
+               capacity = size;
+            }
+         }
+         tasks[tail++] = task;
+      }
+   };
+
+   //resets the queue, when the outermost "schedule" returns (or a task throws)
+   struct Reset
+   {
+      explicit Reset(Queue & q) : q(q) { }
+
+      ~Reset()
+      {
+         q.head = 0;
+         q.tail = 0;
+         q.running = false;
+      }
+
+      Queue & q;
+   };
+
+   static Queue & queue()
+   {
+      static thread_local Queue q;
+      return q;
+   }
+};
+
+
+
+class Subscription
+{
+public:
+   static const size_t UNBOUNDED = (size_t)-1; //demand for "all values there are"
+
+   virtual void unsubscribe() = 0;
+
+   //signal demand for (another) "n" values. a demand-aware observable emits only as many values, as requested.
+   //(observables that aren't demand-aware, like a subject, just ignore it. see backpressure.h for these)
+   virtual void request(size_t n)
+   {
+      (void)n;
+   }
+
+   //true, once the subscription was unsubscribed.
+   //emitting loops check this flag, to stop emitting as soon as nobody is interested in further values
+   bool isClosed() const
+   {
+      return closed.load(std::memory_order_relaxed);
+   }
+
+   //helper for demand-aware implementations: add "n" to "demand" - saturating at UNBOUNDED.
+   //returns false, if the demand was unbounded already
+   static bool addDemand(std::atomic<size_t> & demand, size_t n)
+   {
+      size_t current = demand.load(std::memory_order_acquire);
+      do
+      {
+         if (current == UNBOUNDED) return false;
+      } while (!demand.compare_exchange_weak(current, ((UNBOUNDED - current) > n) ? (current + n) : UNBOUNDED,
+                                             std::memory_order_acq_rel, std::memory_order_acquire));
+      return true;
+   }
+
+protected:
+   Subscription() : closed(false) { }
+
+   std::atomic<bool> closed; //atomic, as it may be set from another thread
+};
+
+
+
+//emission state of a demand-aware observable - packed into a single word, so it costs the observable only 8 bytes:
+//the demand (requested, but not yet emitted values), whether the observer has started, a "done" flag (for the
+//observable's own use) and the drain protocol: only one thread at a time emits. a thread, that wants to emit while
+//another one does (a "request" from within "next" or from another thread), just marks it as missed - and the
+//emitting thread loops again.
+class EmissionState
+{
+public:
+   EmissionState() : word(0) { }
+
+   //add "n" to the demand - saturating at UNBOUNDED. returns false, if the demand was unbounded already
+   bool request(size_t n)
+   {
+      uint64_t current = word.load(std::memory_order_acquire);
+      uint64_t next;
+      do
+      {
+         uint64_t demand = current & DEMAND;
+         if (demand == DEMAND) return false;
+         next = (current & ~DEMAND) | (((DEMAND - demand) > n) ? (demand + n) : DEMAND);
+      } while (!word.compare_exchange_weak(current, next, std::memory_order_acq_rel, std::memory_order_acquire));
+      return true;
+   }
+
+   //the demand (Subscription::UNBOUNDED, if it is unbounded)
+   size_t demand() const
+   {
+      uint64_t demand = word.load(std::memory_order_acquire) & DEMAND;
+      return (demand == DEMAND) ? Subscription::UNBOUNDED : (size_t)demand;
+   }
+
+   //"n" values have been emitted (at most "demand")
+   void consume(size_t n)
+   {
+      uint64_t current = word.load(std::memory_order_relaxed);
+      do
+      {
+         if ((current & DEMAND) == DEMAND) return; //(unbounded stays unbounded)
+      } while (!word.compare_exchange_weak(current, current - n, std::memory_order_acq_rel, std::memory_order_relaxed));
+   }
+
+   void start()
+   {
+      word.fetch_or(STARTED, std::memory_order_acq_rel);
+   }
+
+   bool isStarted() const
+   {
+      return (word.load(std::memory_order_acquire) & STARTED) != 0;
+   }
+
+   void setDone()
+   {
+      word.fetch_or(DONE, std::memory_order_relaxed);
+   }
+
+   bool isDone() const
+   {
+      return (word.load(std::memory_order_relaxed) & DONE) != 0;
+   }
+
+   //returns true, if the calling thread is the one to emit now (then it has to call "leave" afterwards)
+   bool enter()
+   {
+      uint64_t current = word.load(std::memory_order_relaxed);
+      while (!word.compare_exchange_weak(current, current | (((current & EMITTING) != 0) ? MISSED : EMITTING),
+                                         std::memory_order_acq_rel, std::memory_order_relaxed)) { }
+      return (current & EMITTING) == 0;
+   }
+
+   //returns true, if the emitting thread has to loop again (as it was missed in the meantime)
+   bool leave()
+   {
+      uint64_t current = word.load(std::memory_order_relaxed);
+      while (!word.compare_exchange_weak(current, current & (((current & MISSED) != 0) ? ~MISSED : ~EMITTING),
+                                         std::memory_order_acq_rel, std::memory_order_relaxed)) { }
+      return (current & MISSED) != 0;
+   }
+
+private:
+   static const uint64_t EMITTING = (uint64_t)1 << 63;
+   static const uint64_t MISSED = (uint64_t)1 << 62;
+   static const uint64_t STARTED = (uint64_t)1 << 61;
+   static const uint64_t DONE = (uint64_t)1 << 60;
+   static const uint64_t DEMAND = DONE - 1; //(all bits set: unbounded)
+
+   std::atomic<uint64_t> word;
+};
+
+
+
+template <typename V, typename E>
+class Observer
+{
+public:
+   Observer()
+   {
+      this->subscription = nullptr;
+   }
+
+   virtual void next(V const & value) = 0;
+   virtual void error(E const & err) = 0;
+   virtual void complete() = 0;
+
+   //notifies a whole batch of (contiguous) values at once.
+   //by default it just calls one "next" after the other. observers that can do better on contiguous memory
+   //(and mapping observers, that want to forward whole chunks) shall override it.
+   //it stops as soon as the subscription gets unsubscribed (e.g. from within "next").
+   virtual void nextBatch(V const * values, size_t count)
+   {
+      for (size_t i = 0; i < count; i++)
+      {
+         if (isUnsubscribed()) return;
+         next(values[i]);
+      }
+   }
+
+   //called by the observable, right before it starts emitting.
+   //the subscription is kept, so that the observer is able to unsubscribe (e.g. from within "next"),
+   //as soon as it isn't interested in any further values.
+   //by default, the observer requests all values there are. an observer that wants to get the values in its own
+   //pace, overrides "start" (keeping the subscription) and requests as many values as it is able to handle.
+   //(the values are emitted, after "start" has returned)
+   virtual void start(Subscription * subscription)
+   {
+      this->subscription = subscription;
+      subscription->request(Subscription::UNBOUNDED);
+   }
+
+protected:
+   Subscription * subscription; //the subscription of the current emission
+
+   //true, if the subscription of the current emission was unsubscribed
+   bool isUnsubscribed() const
+   {
+      return (subscription != nullptr) && subscription->isClosed();
+   }
+};
+
+
+//this is an intermediate observer, that is used in combination with the map functionality!!!
+template <typename V, typename E>
+class MappingObserver : public Observer<V,E>
+{
+public:
+   Observer<V,E> * observer; //the actuall observer that wants to get notified
+
+   //a mapping observer, that doesn't override "nextBatch" gets the values of a batch one after the other
+   //(by means of Observer::nextBatch) and forwards them single to "observer".
+   //to forward whole chunks, override "nextBatch", map the values into a buffer and pass the buffer
+   //to "observer->nextBatch". (See the *IntMapObserver* in the example.)
+
+   MappingObserver() : pendingDemand(0)
+   {
+      this->observer = nullptr; //set by "map", on subscription
+   }
+
+   MappingObserver(MappingObserver const & other) : Observer<V,E>(other), pendingDemand(0)
+   {
+      this->observer = other.observer;
+   }
+
+   //a mapping observer doesn't request anything on its own. it just passes on the demand of "observer"
+   //(see "request"). the demand requested before the upstream has started, gets passed on now
+   void start(Subscription * subscription)
+   {
+      this->subscription = subscription;
+      size_t n = pendingDemand.exchange(0, std::memory_order_acq_rel);
+      if (n > 0) subscription->request(n);
+   }
+
+   //the demand of "observer" (requested from the "map" observable). by default it is passed on to the upstream.
+   //a mapping observer, that drops values, has to request replacements for them (see "dropped").
+   //a mapping observer, that needs all values (e.g. a reduction), requests UNBOUNDED instead
+   virtual void request(size_t n)
+   {
+      if (this->subscription != nullptr) this->subscription->request(n);
+      else Subscription::addDemand(pendingDemand, n); //upstream hasn't started yet
+   }
+
+protected:
+   //request a replacement for "n" values, that were not forwarded to "observer" (filters)
+   void dropped(size_t n)
+   {
+      if ((n > 0) && (this->subscription != nullptr)) this->subscription->request(n);
+   }
+
+private:
+   std::atomic<size_t> pendingDemand; //demand of "observer", requested before the upstream has started
+};
+
+
+
+#if OBSERVABLE_PROBES
+//sits in front of a stage: counts what the stage gets and measures the time it takes (see instrumentation.h),
+//records a span for each call and an event for error and complete (see trace.h)
+template <typename V, typename E>
+class StageEntryProbe : public Observer<V,E>
+{
+public:
+   Observer<V,E> * stage;
+   StageStats * stats;
+   std::type_info const * type; //of the stage
+
+   void start(Subscription * subscription)
+   {
+      this->subscription = subscription;
+      stage->start(subscription);
+   }
+
+   void next(V const & value)
+   {
+#if OBSERVABLE_TRACING
+      TraceSpan span("next", *type, stage, 1);
+#endif
+#if OBSERVABLE_INSTRUMENTATION
+      StageFrame frame;
+      uint64_t start = stats->enter(1, frame);
+#endif
+      stage->next(value);
+#if OBSERVABLE_INSTRUMENTATION
+      stats->leave(start, frame);
+#endif
+   }
+
+   void nextBatch(V const * values, size_t count)
+   {
+#if OBSERVABLE_TRACING
+      TraceSpan span("nextBatch", *type, stage, count);
+#endif
+#if OBSERVABLE_INSTRUMENTATION
+      StageFrame frame;
+      uint64_t start = stats->enter(count, frame);
+#endif
+      stage->nextBatch(values, count);
+#if OBSERVABLE_INSTRUMENTATION
+      stats->leave(start, frame);
+#endif
+   }
+
+   void error(E const & err)
+   {
+#if OBSERVABLE_TRACING
+      tracing::instant("error", *type, stage);
+#endif
+#if OBSERVABLE_INSTRUMENTATION
+      stats->error();
+#endif
+      stage->error(err);
+   }
+
+   void complete()
+   {
+#if OBSERVABLE_TRACING
+      tracing::instant("complete", *type, stage);
+#endif
+#if OBSERVABLE_INSTRUMENTATION
+      stats->complete();
+#endif
+      stage->complete();
+   }
+};
+
+
+//sits behind a stage: counts what the stage forwards and measures the time spent downstream
+template <typename V, typename E>
+class StageExitProbe : public Observer<V,E>
+{
+public:
+   Observer<V,E> * downstream;
+   StageStats * stats;
+
+   void start(Subscription * subscription)
+   {
+      this->subscription = subscription;
+      downstream->start(subscription);
+   }
+
+   void next(V const & value)
+   {
+#if OBSERVABLE_INSTRUMENTATION
+      uint64_t start = StageStats::now();
+      downstream->next(value);
+      stats->forward(1, StageStats::now() - start);
+#else
+      downstream->next(value);
+#endif
+   }
+
+   void nextBatch(V const * values, size_t count)
+   {
+#if OBSERVABLE_INSTRUMENTATION
+      uint64_t start = StageStats::now();
+      downstream->nextBatch(values, count);
+      stats->forward(count, StageStats::now() - start);
+#else
+      downstream->nextBatch(values, count);
+#endif
+   }
+
+   void error(E const & err)
+   {
+      downstream->error(err);
+   }
+
+   void complete()
+   {
+      downstream->complete();
+   }
+};
+#endif //OBSERVABLE_PROBES
+
+
+
+//callables, that do nothing. (the defaults for "onError" and "onComplete" of a LambdaObserver)
+template <typename E>
+struct IgnoreError
+{
+   void operator()(E const &) const { }
+};
+
+struct IgnoreComplete
+{
+   void operator()() const { }
+};
+
+
+//observer, that calls the given callables (e.g. lambdas) - instead of a hand-written subclass of Observer.
+//the callables are stored inline (no std::function, no allocation). the class is final: where the type of the
+//observer is known (e.g. in a fused pipeline), the compiler calls (and inlines) the callables directly.
+template <typename V, typename E, typename N, typename Er = IgnoreError<E>, typename C = IgnoreComplete>
+class LambdaObserver final : public Observer<V,E>
+{
+public:
+   explicit LambdaObserver(N const & onNext, Er const & onError = Er(), C const & onComplete = C())
+      : onNext(onNext), onError(onError), onComplete(onComplete) { }
+
+   void next(V const & value)
+   {
+      onNext(value);
+   }
+
+   void error(E const & err)
+   {
+      onError(err);
+   }
+
+   void complete()
+   {
+      onComplete();
+   }
+
+private:
+   N onNext;
+   Er onError;
+   C onComplete;
+};
+
+
+//helpers to deduce the types of the callables. e.g.:
+//   auto printer = makeObserver<int, char const *>([](int const & value) { cout << value << endl; });
+
+template <typename V, typename E, typename N>
+LambdaObserver<V,E,N> makeObserver(N const & onNext)
+{
+   return LambdaObserver<V,E,N>(onNext);
+}
+
+template <typename V, typename E, typename N, typename Er>
+LambdaObserver<V,E,N,Er> makeObserver(N const & onNext, Er const & onError)
+{
+   return LambdaObserver<V,E,N,Er>(onNext, onError);
+}
+
+template <typename V, typename E, typename N, typename Er, typename C>
+LambdaObserver<V,E,N,Er,C> makeObserver(N const & onNext, Er const & onError, C const & onComplete)
+{
+   return LambdaObserver<V,E,N,Er,C>(onNext, onError, onComplete);
+}
+
+
+
+//the different kinds of observables (see below).
+//each kind only stores, what it needs to do its "job"
+template <typename V, typename E> class ObservableOf;
+template <typename V, typename E> class ObservableFrom;
+template <typename V, typename E> class ObservableThrowError;
+template <typename V, typename E> class ObservableMap;
+template <typename V, typename E> class ObservableSubscribeOn;
+template <typename V, typename E> class ObservableConcat;
+template <typename V, typename U, typename E, typename F> class ObservableMapTo;
+template <typename V, typename E, typename N, typename Er, typename C> class LambdaSubscription;
+
+
+
+template <typename V, typename E>
+class Observable : protected Subscription //in this exampel, the Observable also implements the Subscription object...
+{
+protected:
+   //typedef for a C++ pointer to a member function
+   //(that takes an pointer to an observer and returns an pointer to a subscription object)
+   typedef Subscription * (Observable::*SubscribeHandler)(Observer<V,E> * observer);
+
+
+   SubscribeHandler subscribeHandler;
+
+   friend class ObservableArena; //the arena has to call the (non public) constructors
+   template <typename V2, typename U2, typename E2, typename F2> friend class ObservableMapTo; //reaches the subscription of its source
+
+
+protected:
+   //constructor is protected - as it shall not be called directly.
+   //instead, a factory function like "from", "of" or "throwError" shall be used!
+   //each factory function constructs the respective kind of observable (derived from this class), which sets
+   //"subscribeHandler" to its own handler method.
+   Observable()
+   {
+      this->subscribeHandler = nullptr;
+   }
+
+
+   //this method implements Subscription::unsubscribe
+   //(the kinds of observables override it, to clear what they hold)
+   void unsubscribe()
+   {
+#if OBSERVABLE_TRACING
+      tracing::instant("unsubscribe", typeid(*this), this);
+#endif
+      //stop a running emission (and prevent any further one)
+      this->closed = true;
+   }
+
+
+   //the kinds of observables are allowed to reach the subscription of other observables this way
+   //(e.g. to pass on an unsubscribe to the upstream observable of a "map")
+   static Subscription * subscriptionOf(Observable * observable)
+   {
+      return observable;
+   }
+
+
+   //allocate a new (empty) observable of the given kind - either on the heap or (if given) in the arena
+   template <typename Kind, typename... Args>
+   static Kind * create(ObservableArena * arena, Args &&... args)
+   {
+      if (arena == nullptr) return new Kind(std::forward<Args>(args)...);
+      return arena->make<Kind>(std::forward<Args>(args)...);
+   }
+
+
+public:
+   //note: all factory functions (and "map") take an optional arena. if given, the observable is placed in the arena
+   //(instead of the heap) and gets destroyed together with all other observables of the arena on "arena.release()"
+
+   //factory function to construct a observable that emits a single value
+   static Observable * of(V value, ObservableArena * arena = nullptr) //call by value
+   {
+      ObservableOf<V,E> * thiz = create< ObservableOf<V,E> >(arena);
+      thiz->value = value; //store a copy the value
+      return thiz;
+   }
+
+   //factory function to construct a observable that emits a series of values
+   static Observable * from(V const * values, size_t count, ObservableArena * arena = nullptr) //values is pointer to (array of) const V(s)
+   {
+      ObservableFrom<V,E> * thiz = create< ObservableFrom<V,E> >(arena);
+      thiz->values = values; //store pointer to the values
+      thiz->end = values + count;
+      return thiz;
+   }
+
+   //factory function to construct a observable that emits an error
+   static Observable * throwError(E err, ObservableArena * arena = nullptr) //call by value
+   {
+      ObservableThrowError<V,E> * thiz = create< ObservableThrowError<V,E> >(arena);
+      thiz->err = err; //make a copy
+      return thiz;
+   }
+
+
+   //create a new Observable, that emits the "next-values" of this stream transformed by the given transformation function
+   Observable * map(MappingObserver<V,E> & mappingObserver, ObservableArena * arena = nullptr)
+   {
+      ObservableMap<V,E> * newobs = create< ObservableMap<V,E> >(arena);
+      newobs->mappingObserver = &mappingObserver;
+      newobs->mappingObservable = this;
+      return newobs;
+   }
+
+
+   //create a new Observable of another value type U, that emits the "next-values" of this stream converted by
+   //the given function (U function(V const &)). the function (e.g. a lambda) is stored inline in the new observable.
+   //e.g.: Observable<double, E> * halves = observable->map<double>([](int const & value) { return value / 2.0; });
+   template <typename U, typename F>
+   Observable<U,E> * map(F const & function, ObservableArena * arena = nullptr)
+   {
+      ObservableMapTo<V,U,E,F> * newobs = create< ObservableMapTo<V,U,E,F> >(arena, function);
+      newobs->source = this;
+      return newobs;
+   }
+
+
+   //create a new Observable, that runs the subscribe handler of this observable by means of the given executor.
+   //so "subscribe" returns immediately and the values get emitted by (e.g. the thread of) the executor.
+   //(this observable has to live, until the executor has run the subscribe handler)
+   Observable * subscribeOn(Executor & executor, ObservableArena * arena = nullptr)
+   {
+      ObservableSubscribeOn<V,E> * newobs = create< ObservableSubscribeOn<V,E> >(arena);
+      newobs->executor = &executor;
+      newobs->source = this;
+      return newobs;
+   }
+
+
+   //create a new Observable, that emits the values of this observable and then (once it has completed) the values
+   //of the "next" one. (an error of this observable ends it - "next" doesn't get subscribed then)
+   Observable * concat(Observable & next, ObservableArena * arena = nullptr)
+   {
+      ObservableConcat<V,E> * newobs = create< ObservableConcat<V,E> >(arena);
+      newobs->first = this;
+      newobs->second = &next;
+      return newobs;
+   }
+
+
+   //this method is a wrapper to call the respective subscribe handler method, set at construction
+   Subscription * subscribe(Observer<V,E> & observer)
+   {
+#if OBSERVABLE_TRACING
+      TraceSpan span("subscribe", typeid(*this), this); //(covers the subscribe handler)
+#endif
+      //if the observable hasn't completed (or was unsubscribed) yet...
+      if ((this->subscribeHandler != nullptr) && !this->isClosed())
+      {
+         //use c++ function-/method-pointer to...
+         return (this->*subscribeHandler)(&observer); //...call either subscribeHandler_of/.._from/.._throwError
+      }
+      //otherwise: the observable has already completed
+      //subscription has no further effect, than just returning an Subscription object
+      return this; //as Observable derives from Subscription it is very easy at this point to return an Subscription object
+   }
+
+
+   //subscribe with callables (e.g. lambdas) for next, error and complete - instead of an observer object.
+   //the returned object holds the (LambdaObserver with the) callables. it has to be kept, as long as the
+   //observable emits. (no need to keep it, if the observable emits synchronously - within "subscribe")
+   //   auto subscription = observable->subscribe([](int const & value) { cout << value << endl; });
+   template <typename N, typename Er = IgnoreError<E>, typename C = IgnoreComplete,
+             typename std::enable_if<!std::is_base_of<Observer<V,E>, N>::value, int>::type = 0>
+   LambdaSubscription<V,E,N,Er,C> subscribe(N const & onNext, Er const & onError = Er(), C const & onComplete = C())
+   {
+      return LambdaSubscription<V,E,N,Er,C>(this, onNext, onError, onComplete);
+   }
+
+
+   //the size (in bytes) of each kind of observable
+   struct Sizes
+   {
+      size_t of;
+      size_t from;
+      size_t throwError;
+      size_t map;
+      size_t subscribeOn;
+      size_t concat;
+   };
+
+   static Sizes sizes()
+   {
+      Sizes s;
+      s.of = sizeof(ObservableOf<V,E>);
+      s.from = sizeof(ObservableFrom<V,E>);
+      s.throwError = sizeof(ObservableThrowError<V,E>);
+      s.map = sizeof(ObservableMap<V,E>);
+      s.subscribeOn = sizeof(ObservableSubscribeOn<V,E>);
+      s.concat = sizeof(ObservableConcat<V,E>);
+      return s;
+   }
+};
+
+
+
+//the subscription of "subscribe" with callables. it holds the observer, that calls the callables
+//(so it must not be copied or moved - it is constructed in place, where it is returned to)
+template <typename V, typename E, typename N, typename Er, typename C>
+class LambdaSubscription
+{
+public:
+   LambdaSubscription(Observable<V,E> * observable, N const & onNext, Er const & onError, C const & onComplete)
+      : observer(onNext, onError, onComplete)
+   {
+      subscription = observable->subscribe(observer);
+   }
+
+   Subscription * get() const
+   {
+      return subscription;
+   }
+
+   Subscription * operator->() const
+   {
+      return subscription;
+   }
+
+private:
+   LambdaObserver<V,E,N,Er,C> observer;
+   Subscription * subscription;
+
+   LambdaSubscription(LambdaSubscription const &);
+   LambdaSubscription & operator=(LambdaSubscription const &);
+};
+//observable constructed using the "of" method
+template <typename V, typename E>
+class ObservableOf : public Observable<V,E>
+{
+private:
+   V value;
+   Observer<V,E> * observer;
+   EmissionState state; //(done: the value has been emitted)
+
+   friend class Observable<V,E>;
+   friend class ObservableArena;
+
+   ObservableOf()
+   {
+      //a pointer to a method of a derived class can be converted to a pointer to a method of the base class,
+      //as long as it gets invoked on an object of the derived class (which is always the case here)
+      this->subscribeHandler = static_cast<typename Observable<V,E>::SubscribeHandler>(&ObservableOf::subscribeHandler_of);
+      this->observer = nullptr;
+   }
+
+   //this is the method that is called when someone subscribes to the observable that was constructed...
+   //...using the "of" method
+   Subscription * subscribeHandler_of(Observer<V,E> * observer)
+   {
+      //prevent further invocation, by setting the handler fuction to NULL (there is only room for one observer)
+      this->subscribeHandler = nullptr;
+      this->observer = observer;
+      //pass the subscription object to the observer (so it is able to unsubscribe early - and to request the value)
+      observer->start(this);
+      state.start();
+      //emit (the one and only) "next" - if it was requested
+      drain();
+      //as Observable derives from Subscription it is very easy at this point to return an Subscription object
+      return this;
+   }
+
+   void request(size_t n)
+   {
+      if (state.request(n)) drain();
+   }
+
+   //emit the value and complete, as soon as it is requested. only one thread at a time does so (see EmissionState)
+   void drain()
+   {
+      if (!state.enter()) return;
+      do
+      {
+         if (state.isStarted() && !state.isDone() && !this->isClosed() && (state.demand() > 0))
+         {
+            state.setDone();
+            observer->next(value);
+            //finally complete
+            if (!this->isClosed()) observer->complete();
+         }
+      } while (state.leave());
+   }
+};
+
+
+
+//base of the observables, that emit the values of an array in memory ("from" - and e.g. "fromMappedFile").
+//the values are passed in batches, as many as requested
+template <typename V, typename E>
+class ObservableArray : public Observable<V,E>
+{
+protected:
+   static const size_t BATCH_SIZE = 1024; //max. number of values passed at once to "nextBatch"
+
+   V const * values; //the next value to emit
+   V const * end; //behind the last value
+   Observer<V,E> * observer;
+   EmissionState state; //(done: complete has been emitted)
+
+   ObservableArray()
+   {
+      this->subscribeHandler = static_cast<typename Observable<V,E>::SubscribeHandler>(&ObservableArray::subscribeHandler_array);
+      this->values = nullptr;
+      this->end = nullptr;
+      this->observer = nullptr;
+   }
+
+   //hooks for derived observables, that hold the memory of the values (see ObservableMappedFile).
+   //both are called by the emitting thread: "emitted" after each batch, "clear" as soon as the values aren't needed
+   //any more (all of them have been emitted or the observer has unsubscribed)
+   virtual void emitted() { }
+
+   virtual void clear()
+   {
+      this->values = nullptr;
+      this->end = nullptr;
+   }
+
+   //this is the method that is called when someone subscribes to the observable that was constructed...
+   //...using the "from" method
+   Subscription * subscribeHandler_array(Observer<V,E> * observer)
+   {
+      //prevent further invocation, by setting the handler fuction to NULL (there is only room for one observer)
+      this->subscribeHandler = nullptr;
+      this->observer = observer;
+      //pass the subscription object to the observer (so it is able to unsubscribe early - and to request values)
+      observer->start(this);
+      state.start();
+      //emit as many values as requested. (if not all of them, "request" continues later)
+      drain();
+      //as Observable derives from Subscription it is very easy at this point to return an Subscription object
+      return this;
+   }
+
+   void request(size_t n)
+   {
+      if (state.request(n)) drain();
+   }
+
+   void unsubscribe()
+   {
+      Observable<V,E>::unsubscribe();
+      drain(); //clears all (unless another thread is emitting right now - then that one does)
+   }
+
+   //emit the requested values. only one thread at a time does so (see EmissionState)
+   void drain()
+   {
+      if (!state.enter()) return;
+      do
+      {
+         if (this->isClosed())
+         {
+            clear();
+         }
+         else if (state.isStarted())
+         {
+            //pass the values in batches (the observer falls back to one "next" after the other, if it can't do better).
+            //between the batches check, if the observer has unsubscribed in the meantime - and stop emitting if so
+            while ((values != end) && !this->isClosed())
+            {
+               size_t n = state.demand();
+               if (n == 0) break; //wait for the next "request"
+               size_t batch = (size_t)(end - values);
+               if (batch > BATCH_SIZE) batch = BATCH_SIZE;
+               if (batch > n) batch = n;
+               state.consume(batch);
+               values += batch;
+               observer->nextBatch(values - batch, batch);
+               emitted();
+            }
+            //finally complete (no demand needed for that)
+            if ((values == end) && !state.isDone() && !this->isClosed())
+            {
+               state.setDone();
+               clear(); //everything has been emitted
+               observer->complete();
+            }
+         }
+      } while (state.leave());
+   }
+};
+
+
+
+//observable constructed using the "from" method
+template <typename V, typename E>
+class ObservableFrom : public ObservableArray<V,E>
+{
+private:
+   friend class Observable<V,E>;
+   friend class ObservableArena;
+
+   ObservableFrom()
+   {
+   }
+};
+
+
+
+//observable constructed using the "throwError" method
+template <typename V, typename E>
+class ObservableThrowError : public Observable<V,E>
+{
+private:
+   E err;
+
+   friend class Observable<V,E>;
+   friend class ObservableArena;
+
+   ObservableThrowError()
+   {
+      this->subscribeHandler = static_cast<typename Observable<V,E>::SubscribeHandler>(&ObservableThrowError::subscribeHandler_throwError);
+   }
+
+   //this is the method that is called when someone subscribes to the observable that was constructed...
+   //...using the "throwError" method
+   Subscription * subscribeHandler_throwError(Observer<V,E> * observer)
+   {
+      //pass the subscription object to the observer (so it is able to unsubscribe early)
+      observer->start(this);
+      //call error
+      if (!this->isClosed()) observer->error(err);
+      //finally complete
+      if (!this->isClosed()) observer->complete();
+      //prevent further invocation, by setting the handler fuction to NULL (as the observable has completed now!)
+      this->subscribeHandler = nullptr;
+      //as Observable derives from Subscription it is very easy at this point to return an Subscription object
+      return this;
+   }
+
+   void unsubscribe()
+   {
+      Observable<V,E>::unsubscribe();
+      //clear all
+      this->err = E();
+   }
+};
+
+
+
+//observable constructed using the "map" method of another observable
+template <typename V, typename E>
+class ObservableMap : public Observable<V,E>
+{
+private:
+   MappingObserver<V,E> * mappingObserver;
+   Observable<V,E> * mappingObservable;
+   std::atomic<Subscription *> upstream; //the subscription, the mapping-observable has returned
+#if OBSERVABLE_PROBES
+#if OBSERVABLE_INSTRUMENTATION
+   StageStats stats;
+#endif
+   StageEntryProbe<V,E> entryProbe;
+   StageExitProbe<V,E> exitProbe;
+#endif
+
+   friend class Observable<V,E>;
+   friend class ObservableArena;
+
+   ObservableMap() : upstream(nullptr)
+   {
+      this->subscribeHandler = static_cast<typename Observable<V,E>::SubscribeHandler>(&ObservableMap::subscribeHandler_map);
+      this->mappingObserver = nullptr;
+      this->mappingObservable = nullptr;
+   }
+
+   //this is the method that is called when someone subscribes to the observable that was constructed...
+   //... using the "map" method of another observable
+   Subscription * subscribeHandler_map(Observer<V,E> * observer)
+   {
+      //the observer gets "this" as subscription object. unsubscribing from it, is passed on to the mapping-observable
+      observer->start(this);
+#if OBSERVABLE_PROBES
+      //wrap the mapping observer by the probes
+#if OBSERVABLE_INSTRUMENTATION
+      stats.attach(typeid(*mappingObserver));
+      entryProbe.stats = &stats;
+      exitProbe.stats = &stats;
+#endif
+      entryProbe.stage = mappingObserver;
+      entryProbe.type = &typeid(*mappingObserver);
+      exitProbe.downstream = observer;
+      mappingObserver->observer = &exitProbe;
+#else
+      mappingObserver->observer = observer;
+#endif
+      //subscribe to the mapping-observable by means of the trampoline. so a chain of "map"s is subscribed in a loop
+      //(instead of one nested call per "map"). the outermost "subscribe" returns, once all of them are done
+      Task task = { &ObservableMap::subscribeUpstream, this };
+      Trampoline::schedule(task);
+      return this;
+   }
+
+   static void subscribeUpstream(void * context)
+   {
+      ObservableMap * thiz = (ObservableMap *)context;
+      if (thiz->isClosed()) return; //unsubscribed in the meantime
+#if OBSERVABLE_PROBES
+      Subscription * subscription = thiz->mappingObservable->subscribe(thiz->entryProbe);
+#else
+      Subscription * subscription = thiz->mappingObservable->subscribe(*thiz->mappingObserver);
+#endif
+      thiz->upstream.store(subscription);
+      if (thiz->closed.load()) subscription->unsubscribe(); //unsubscribed (by another thread) in the meantime
+   }
+
+   //the demand of the observer is handled by the mapping observer (by default it passes it on to the mapping-observable)
+   void request(size_t n)
+   {
+      mappingObserver->request(n);
+   }
+
+   void unsubscribe()
+   {
+      if (this->closed.exchange(true)) return; //passed on already (a subject frees its subscription on unsubscribe)
+      Observable<V,E>::unsubscribe();
+      //pass on to the mapping-observable (to stop its emission).
+      //(the mapping-observable may return another subscription than itself - e.g. a subject)
+      Subscription * subscription = upstream.load();
+      if (subscription == nullptr) subscription = this->subscriptionOf(mappingObservable);
+      subscription->unsubscribe();
+   }
+};
+
+
+
+//observable constructed using the "subscribeOn" method of another observable
+template <typename V, typename E>
+class ObservableSubscribeOn : public Observable<V,E>
+{
+private:
+   Executor * executor;
+   Observable<V,E> * source;
+   Observer<V,E> * observer;
+   std::atomic<Subscription *> upstream; //the subscription, the source observable has returned
+
+   friend class Observable<V,E>;
+   friend class ObservableArena;
+
+   ObservableSubscribeOn() : upstream(nullptr)
+   {
+      this->subscribeHandler = static_cast<typename Observable<V,E>::SubscribeHandler>(&ObservableSubscribeOn::subscribeHandler_subscribeOn);
+      this->executor = nullptr;
+      this->source = nullptr;
+      this->observer = nullptr;
+   }
+
+   //this is the method that is called when someone subscribes to the observable that was constructed...
+   //... using the "subscribeOn" method of another observable
+   Subscription * subscribeHandler_subscribeOn(Observer<V,E> * observer)
+   {
+      this->observer = observer;
+      //prevent further invocation (there is only room for one observer)
+      this->subscribeHandler = nullptr;
+      //let the executor subscribe to the source observable - and return immediately
+      Task task = { &ObservableSubscribeOn::run, this };
+      executor->execute(task);
+      return this;
+   }
+
+   //the task, the executor runs
+   static void run(void * context)
+   {
+      ObservableSubscribeOn * thiz = (ObservableSubscribeOn *)context;
+      if (thiz->isClosed()) return; //unsubscribed, before the executor got to it
+      Subscription * subscription = thiz->source->subscribe(*thiz->observer);
+      thiz->upstream.store(subscription);
+      if (thiz->closed.load()) subscription->unsubscribe(); //unsubscribed in the meantime
+   }
+
+   void request(size_t n)
+   {
+      Subscription * subscription = upstream.load();
+      if (subscription == nullptr) subscription = this->subscriptionOf(source);
+      subscription->request(n);
+   }
+
+   void unsubscribe()
+   {
+      if (this->closed.exchange(true)) return; //passed on already
+      Observable<V,E>::unsubscribe();
+      //pass on to the source observable (to stop its emission)
+      Subscription * subscription = upstream.load();
+      if (subscription == nullptr) subscription = this->subscriptionOf(source);
+      subscription->unsubscribe();
+   }
+};
+
+
+
+//observable constructed using the "concat" method of another observable
+template <typename V, typename E>
+class ObservableConcat : public Observable<V,E>
+{
+private:
+   //subscribes to the first, then to the second observable and passes everything on to the observer
+   class Relay : public Observer<V,E>
+   {
+   public:
+      ObservableConcat * concat;
+
+      //the demand, that is left, is requested from each observable anew
+      void start(Subscription * subscription)
+      {
+         this->subscription = subscription;
+         concat->current.store(subscription);
+         size_t n = concat->demand.load(std::memory_order_acquire);
+         if (n > 0) subscription->request(n);
+      }
+
+      void next(V const & value)
+      {
+         nextBatch(&value, 1);
+      }
+
+      void nextBatch(V const * values, size_t count)
+      {
+         if (concat->demand.load(std::memory_order_relaxed) != Subscription::UNBOUNDED)
+         {
+            concat->demand.fetch_sub(count, std::memory_order_acq_rel);
+         }
+         concat->observer->nextBatch(values, count);
+      }
+
+      void error(E const & err)
+      {
+         concat->failed = true;
+         concat->observer->error(err);
+      }
+
+      void complete()
+      {
+         if (concat->onSecond || concat->failed)
+         {
+            concat->observer->complete();
+            return;
+         }
+         //subscribe to the second observable - by means of the trampoline. so it doesn't happen from within the
+         //emission of the first one (the stack doesn't grow with each "concat")
+         concat->onSecond = true;
+         Task task = { &ObservableConcat::subscribeSecond, concat };
+         Trampoline::schedule(task);
+      }
+   };
+
+   Observable<V,E> * first;
+   Observable<V,E> * second;
+   Observer<V,E> * observer;
+   Relay relay;
+   std::atomic<Subscription *> current; //the subscription of the observable, that is emitting right now
+   std::atomic<size_t> demand; //requested, but not yet emitted values
+   bool onSecond;
+   bool failed;
+
+   friend class Observable<V,E>;
+   friend class ObservableArena;
+
+   ObservableConcat() : current(nullptr), demand(0)
+   {
+      this->subscribeHandler = static_cast<typename Observable<V,E>::SubscribeHandler>(&ObservableConcat::subscribeHandler_concat);
+      this->first = nullptr;
+      this->second = nullptr;
+      this->observer = nullptr;
+      this->relay.concat = this;
+      this->onSecond = false;
+      this->failed = false;
+   }
+
+   //this is the method that is called when someone subscribes to the observable that was constructed...
+   //... using the "concat" method of another observable
+   Subscription * subscribeHandler_concat(Observer<V,E> * observer)
+   {
+      //prevent further invocation (there is only room for one observer)
+      this->subscribeHandler = nullptr;
+      this->observer = observer;
+      observer->start(this);
+      Task task = { &ObservableConcat::subscribeFirst, this };
+      Trampoline::schedule(task);
+      return this;
+   }
+
+   static void subscribeFirst(void * context)
+   {
+      ObservableConcat * thiz = (ObservableConcat *)context;
+      if (thiz->isClosed()) return; //unsubscribed in the meantime
+      thiz->first->subscribe(thiz->relay);
+   }
+
+   static void subscribeSecond(void * context)
+   {
+      ObservableConcat * thiz = (ObservableConcat *)context;
+      if (thiz->isClosed()) return; //unsubscribed in the meantime
+      thiz->second->subscribe(thiz->relay);
+   }
+
+   void request(size_t n)
+   {
+      if (!Subscription::addDemand(demand, n)) return;
+      Subscription * subscription = current.load();
+      if (subscription != nullptr) subscription->request(n);
+   }
+
+   void unsubscribe()
+   {
+      if (this->closed.exchange(true)) return; //passed on already
+      Observable<V,E>::unsubscribe();
+      //pass on to the observable, that is emitting right now
+      Subscription * subscription = current.load();
+      if (subscription != nullptr) subscription->unsubscribe();
+   }
+};
+
+
+
+//observable constructed using the (type changing) "map" method of another observable
+template <typename V, typename U, typename E, typename F>
+class ObservableMapTo : public Observable<U,E>
+{
+private:
+   //max. number of converted values passed at once to "nextBatch". the chunk is on the stack, so it is bounded by
+   //its size (4 KiB) - at least one value
+   static const size_t CHUNK = (sizeof(U) < 4096) ? (4096 / sizeof(U)) : 1;
+
+   //subscribes to the source observable, converts its values and passes them on to the observer
+   //values constructed in raw storage. they get destroyed, when it goes out of scope (also if "function" throws)
+   struct Constructed
+   {
+      explicit Constructed(U * values)
+      {
+         this->values = values;
+         this->count = 0;
+      }
+
+      ~Constructed()
+      {
+         for (size_t i = 0; i < count; i++) values[i].~U();
+      }
+
+      U * values;
+      size_t count;
+   };
+
+   class Converter : public Observer<V,E>
+   {
+   public:
+      ObservableMapTo * node;
+
+      //the demand of the observer, requested before the source has started, gets passed on now
+      void start(Subscription * subscription)
+      {
+         this->subscription = subscription;
+         node->upstream.store(subscription);
+         size_t n = node->pendingDemand.exchange(0);
+         if (n > 0) subscription->request(n);
+      }
+
+      void next(V const & value)
+      {
+         node->observer->next(node->function(value));
+      }
+
+      //the values are converted into raw storage. so U needs no default constructor and only the converted
+      //values get constructed (and destroyed)
+      void nextBatch(V const * values, size_t count)
+      {
+         alignas(U) unsigned char storage[CHUNK * sizeof(U)];
+         U * converted = (U *)storage;
+         while ((count > 0) && !this->isUnsubscribed())
+         {
+            size_t n = (count < CHUNK) ? count : CHUNK;
+            Constructed chunk(converted);
+            while (chunk.count < n)
+            {
+               new (converted + chunk.count) U(node->function(values[chunk.count]));
+               chunk.count++;
+            }
+            node->observer->nextBatch(converted, n);
+            values += n;
+            count -= n;
+         }
+      }
+
+      void error(E const & err)
+      {
+         node->observer->error(err);
+      }
+
+      void complete()
+      {
+         node->observer->complete();
+      }
+   };
+
+   F function;
+   Observable<V,E> * source;
+   Observer<U,E> * observer;
+   Converter converter;
+   std::atomic<Subscription *> upstream; //the subscription of the source observable (once it has started)
+   std::atomic<size_t> pendingDemand; //demand of the observer, requested before the source has started
+#if OBSERVABLE_PROBES
+#if OBSERVABLE_INSTRUMENTATION
+   StageStats stats;
+#endif
+   StageEntryProbe<V,E> entryProbe;
+   StageExitProbe<U,E> exitProbe;
+#endif
+
+   friend class Observable<V,E>;
+   friend class ObservableArena;
+
+   explicit ObservableMapTo(F const & function) : function(function), upstream(nullptr), pendingDemand(0)
+   {
+      this->subscribeHandler = static_cast<typename Observable<U,E>::SubscribeHandler>(&ObservableMapTo::subscribeHandler_mapTo);
+      this->source = nullptr;
+      this->observer = nullptr;
+      this->converter.node = this;
+   }
+
+   //this is the method that is called when someone subscribes to the observable that was constructed...
+   //... using the (type changing) "map" method of another observable
+   Subscription * subscribeHandler_mapTo(Observer<U,E> * observer)
+   {
+      //prevent further invocation (there is only room for one observer)
+      this->subscribeHandler = nullptr;
+      this->observer = observer;
+      observer->start(this);
+#if OBSERVABLE_PROBES
+      //wrap the converter by the probes
+#if OBSERVABLE_INSTRUMENTATION
+      stats.attach(typeid(U), "map to ");
+      entryProbe.stats = &stats;
+      exitProbe.stats = &stats;
+#endif
+      entryProbe.stage = &converter;
+      entryProbe.type = &typeid(ObservableMapTo);
+      exitProbe.downstream = observer;
+      this->observer = &exitProbe;
+#endif
+      Task task = { &ObservableMapTo::subscribeSource, this };
+      Trampoline::schedule(task);
+      return this;
+   }
+
+   static void subscribeSource(void * context)
+   {
+      ObservableMapTo * thiz = (ObservableMapTo *)context;
+      if (thiz->isClosed()) return; //unsubscribed in the meantime
+#if OBSERVABLE_PROBES
+      Subscription * subscription = thiz->source->subscribe(thiz->entryProbe);
+#else
+      Subscription * subscription = thiz->source->subscribe(thiz->converter);
+#endif
+      thiz->upstream.store(subscription);
+      if (thiz->closed.load()) subscription->unsubscribe(); //unsubscribed (by another thread) in the meantime
+   }
+
+   void request(size_t n)
+   {
+      Subscription::addDemand(pendingDemand, n);
+      Subscription * subscription = upstream.load();
+      if (subscription == nullptr) return; //passed on, once the source has started
+      n = pendingDemand.exchange(0);
+      if (n > 0) subscription->request(n);
+   }
+
+   void unsubscribe()
+   {
+      if (this->closed.exchange(true)) return; //passed on already
+      Observable<U,E>::unsubscribe();
+      //pass on to the source observable (to stop its emission)
+      Subscription * subscription = upstream.load();
+      if (subscription == nullptr) subscription = Observable<V,E>::subscriptionOf(source);
+      subscription->unsubscribe();
+   }
+};
+
+#endif
@@ -0,0 +1,211 @@
+//-----------------------------------------------------------------------------
+/*!
+   \file
+   \brief Limiting operators: take, takeWhile and first.
+
+   These are mapping observers (to be used with "map"), that forward only the first values of a stream.
+   As soon as they have got enough, they don't just stop forwarding: they complete the downstream observer
+   and unsubscribe from the upstream observable. So the upstream observable stops emitting immediately
+   (and releases what it holds). Combined with "from" over a large buffer, a scan stops after the values
+   that are actually needed.
+
+      TakeObserver<int, char const *> firstThree(3);
+      IntObservable::from(values, count)->map(firstThree)->subscribe(observer);
+*/
+//-----------------------------------------------------------------------------
+#ifndef OPERATORS_H
+#define OPERATORS_H
+
+/* -- Includes ------------------------------------------------------------ */
+#include <stddef.h>
+#include "observable.h"
+
+
+/* -- Types --------------------------------------------------------------- */
+
+//base of the limiting operators: completes the downstream and unsubscribes from the upstream, when "done"
+template <typename V, typename E>
+class LimitingObserver : public MappingObserver<V,E>
+{
+public:
+   LimitingObserver()
+   {
+      this->done = false;
+      this->failed = false;
+   }
+
+   //an error of the upstream stops the operator as well. (the complete, that follows, is still passed on)
+   void error(E const & err)
+   {
+      if (done) return;
+      done = true;
+      failed = true;
+      this->observer->error(err);
+   }
+
+   void complete()
+   {
+      if (done && !failed) return;
+      done = true;
+      failed = false; //(complete is passed on only once)
+      this->observer->complete();
+   }
+
+protected:
+   bool done; //once done, all further notifications are ignored (in case the upstream doesn't stop emitting)
+   bool failed; //done, because the upstream has emitted an error (its complete is yet to come)
+
+   //the operator has got enough values
+   void finish()
+   {
+      if (done) return;
+      done = true;
+      if (this->subscription != nullptr) this->subscription->unsubscribe(); //stop the upstream...
+      this->observer->complete(); //...and complete the downstream
+   }
+};
+
+
+
+//forwards (only) the first "count" values, then completes
+template <typename V, typename E>
+class TakeObserver : public LimitingObserver<V,E>
+{
+public:
+   explicit TakeObserver(size_t count)
+   {
+      this->count = count;
+      this->taken = 0;
+   }
+
+   void start(Subscription * subscription)
+   {
+      LimitingObserver<V,E>::start(subscription);
+      if (count == 0) this->finish(); //nothing to take at all
+   }
+
+   void next(V const & value)
+   {
+      nextBatch(&value, 1);
+   }
+
+   void nextBatch(V const * values, size_t n)
+   {
+      if (this->done) return;
+      size_t remaining = count - taken;
+      if (n > remaining) n = remaining;
+      taken += n;
+      if (n > 0) this->observer->nextBatch(values, n); //forward as one batch
+      if (taken == count) this->finish();
+   }
+
+private:
+   size_t count;
+   size_t taken;
+};
+
+
+
+//forwards the values as long as the predicate holds for them. completes on the first value it doesn't
+template <typename V, typename E, typename P>
+class TakeWhileObserver : public LimitingObserver<V,E>
+{
+public:
+   explicit TakeWhileObserver(P const & predicate) : predicate(predicate) { }
+
+   void next(V const & value)
+   {
+      nextBatch(&value, 1);
+   }
+
+   void nextBatch(V const * values, size_t n)
+   {
+      if (this->done) return;
+      size_t i = 0;
+      while ((i < n) && predicate(values[i])) i++;
+      if (i > 0) this->observer->nextBatch(values, i); //forward the leading values, the predicate holds for
+      if (i < n) this->finish();
+   }
+
+private:
+   P predicate;
+};
+
+
+
+//predicate that holds for any value (the default of FirstObserver)
+template <typename V>
+struct AnyValue
+{
+   bool operator()(V const &) const { return true; }
+};
+
+
+//forwards the first value (the predicate holds for), then completes.
+//if the upstream completes without such a value, "emptyError" is emitted.
+template <typename V, typename E, typename P = AnyValue<V> >
+class FirstObserver : public LimitingObserver<V,E>
+{
+public:
+   explicit FirstObserver(E emptyError, P const & predicate = P()) : predicate(predicate)
+   {
+      this->emptyError = emptyError;
+   }
+
+   void next(V const & value)
+   {
+      nextBatch(&value, 1);
+   }
+
+   void nextBatch(V const * values, size_t n)
+   {
+      if (this->done) return;
+      for (size_t i = 0; i < n; i++)
+      {
+         if (predicate(values[i]))
+         {
+            this->observer->next(values[i]);
+            this->finish();
+            return;
+         }
+      }
+      this->dropped(n); //none of them matched. request replacements
+   }
+
+   void complete()
+   {
+      if (this->done)
+      {
+         LimitingObserver<V,E>::complete(); //(after an error of the upstream, its complete is passed on)
+         return;
+      }
+      this->done = true;
+      this->observer->error(emptyError); //completed without a (matching) value...
+      this->observer->complete(); //...complete anyway (as "throwError" does)
+   }
+
+private:
+   E emptyError;
+   P predicate;
+};
+
+
+
+/* -- Factory functions --------------------------------------------------- */
+
+//helpers to deduce the type of the predicate. e.g.:
+//   auto positive = takeWhile<int, char const *>([](int const & value) { return value > 0; });
+
+template <typename V, typename E, typename P>
+TakeWhileObserver<V,E,P> takeWhile(P const & predicate)
+{
+   return TakeWhileObserver<V,E,P>(predicate);
+}
+
+template <typename V, typename E, typename P>
+FirstObserver<V,E,P> first(E emptyError, P const & predicate)
+{
+   return FirstObserver<V,E,P>(emptyError, predicate);
+}
+
+#endif
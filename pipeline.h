@@ -0,0 +1,211 @@
+//-----------------------------------------------------------------------------
+/*!
+   \file
+   \brief Statically dispatched ("fused") operator pipelines.
+
+   The Observable/Observer classes in observable.h are glued together at runtime: every value goes through a virtual
+   Observer::next call and every map stage adds another indirect hop through MappingObserver::observer.
+   That's nice to see what's going on under the hood, but it costs an indirect call per value and stage.
+
+   If all stages are known at compile time, the same chain can be glued together by templates instead:
+
+      fused::from(values, count) | fused::map(f) | fused::filter(p) | fused::subscribe(observer);
+
+   Each stage is a tiny struct that knows the (concrete) type of its downstream. So the compiler sees the
+   whole chain and inlines it into one single loop over the values array - without any virtual call left.
+*/
+//-----------------------------------------------------------------------------
+#ifndef PIPELINE_H
+#define PIPELINE_H
+
+/* -- Includes ------------------------------------------------------------ */
+#include <stddef.h>
+
+
+/* -- Types --------------------------------------------------------------- */
+
+namespace fused
+{
+
+//the source of a fused pipeline. it emits a series of values (like Observable::from)
+template <typename V>
+class From
+{
+public:
+   From(V const * values, size_t count)
+   {
+      this->values = values;
+      this->count = count;
+   }
+
+   //run the pipeline. "sink" is the first stage (or the final observer)
+   template <typename Sink>
+   void run(Sink & sink) const
+   {
+      for (size_t i = 0; i < count; i++) sink.next(values[i]);
+      sink.complete();
+   }
+
+private:
+   V const * values;
+   size_t count;
+};
+
+
+
+//the "runtime" part of a map stage. it transforms each value and passes it to the next stage
+template <typename F, typename Down>
+class MapSink
+{
+public:
+   MapSink(F const & f, Down & down) : f(f), down(down) { }
+
+   template <typename T>
+   void next(T const & value) { down.next(f(value)); }
+
+   template <typename Err>
+   void error(Err const & err) { down.error(err); }
+
+   void complete() { down.complete(); }
+
+private:
+   F f; //own copy, so that even "mutable" lambdas start with a fresh state on each run
+   Down & down;
+};
+
+
+//the "runtime" part of a filter stage. it passes only those values to the next stage, the predicate holds for
+template <typename P, typename Down>
+class FilterSink
+{
+public:
+   FilterSink(P const & p, Down & down) : p(p), down(down) { }
+
+   template <typename T>
+   void next(T const & value) { if (p(value)) down.next(value); }
+
+   template <typename Err>
+   void error(Err const & err) { down.error(err); }
+
+   void complete() { down.complete(); }
+
+private:
+   P p;
+   Down & down;
+};
+
+
+
+//the "build time" part of a map stage, as returned by fused::map
+template <typename F>
+class Map
+{
+public:
+   explicit Map(F const & f) : f(f) { }
+
+   template <typename Down>
+   MapSink<F,Down> bind(Down & down) const { return MapSink<F,Down>(f, down); }
+
+private:
+   F f;
+};
+
+
+//the "build time" part of a filter stage, as returned by fused::filter
+template <typename P>
+class Filter
+{
+public:
+   explicit Filter(P const & p) : p(p) { }
+
+   template <typename Down>
+   FilterSink<P,Down> bind(Down & down) const { return FilterSink<P,Down>(p, down); }
+
+private:
+   P p;
+};
+
+
+
+//a source followed by a stage - which is a source again. result of "source | stage"
+template <typename Source, typename Stage>
+class Chain
+{
+public:
+   Chain(Source const & source, Stage const & stage) : source(source), stage(stage) { }
+
+   template <typename Sink>
+   void run(Sink & sink) const
+   {
+      auto bound = stage.bind(sink); //connect the stage to its downstream...
+      source.run(bound); //...and let the upstream feed it
+   }
+
+private:
+   Source source;
+   Stage stage;
+};
+
+
+
+//terminal of a pipeline, as returned by fused::subscribe
+//the observer may be any object with next, error and complete methods (e.g. an Observer<V,E>)
+template <typename O>
+class Subscribe
+{
+public:
+   explicit Subscribe(O & observer) : observer(observer) { }
+
+   O & observer;
+};
+
+
+
+/* -- Factory functions --------------------------------------------------- */
+
+template <typename V>
+From<V> from(V const * values, size_t count) { return From<V>(values, count); }
+
+template <typename F>
+Map<F> map(F const & f) { return Map<F>(f); }
+
+template <typename P>
+Filter<P> filter(P const & p) { return Filter<P>(p); }
+
+template <typename O>
+Subscribe<O> subscribe(O & observer) { return Subscribe<O>(observer); }
+
+
+
+/* -- Operators ----------------------------------------------------------- */
+
+//source | stage -> new source
+template <typename V, typename Stage>
+Chain<From<V>,Stage> operator|(From<V> const & source, Stage const & stage)
+{
+   return Chain<From<V>,Stage>(source, stage);
+}
+
+template <typename Source, typename Inner, typename Stage>
+Chain<Chain<Source,Inner>,Stage> operator|(Chain<Source,Inner> const & source, Stage const & stage)
+{
+   return Chain<Chain<Source,Inner>,Stage>(source, stage);
+}
+
+
+//source | subscribe(observer) -> runs the pipeline
+template <typename V, typename O>
+void operator|(From<V> const & source, Subscribe<O> const & terminal)
+{
+   source.run(terminal.observer);
+}
+
+template <typename Source, typename Inner, typename O>
+void operator|(Chain<Source,Inner> const & source, Subscribe<O> const & terminal)
+{
+   source.run(terminal.observer);
+}
+
+} //namespace fused
+
+#endif
@@ -0,0 +1,553 @@
+//-----------------------------------------------------------------------------
+/*!
+   \file
+   \brief Executors (inline, dedicated thread, thread pool) and the observeOn operator.
+
+   Everything in observable.h runs synchronously on the thread that calls "subscribe". The executors in here
+   (implementing the Executor interface of observable.h) move that work to other threads:
+
+   - "subscribeOn" runs the subscribe handler of an observable by means of an executor:
+
+      ThreadExecutor thread;
+      observable->subscribeOn(thread)->subscribe(observer); //returns immediately. the values get emitted by "thread"
+
+   - ObserveOnObserver moves the delivery of next/error/complete to another thread:
+
+      ThreadPool pool(4);
+      ObserveOnObserver<int, char const *> onPool(pool);
+      observable->map(onPool)->subscribe(slowObserver); //slowObserver gets notified by one of the pool's threads
+
+   The notifications are handed over through a bounded, lock-free single-producer/single-consumer ring queue.
+   The thread pool itself gets its tasks through bounded, lock-free multi-producer/single-consumer queues
+   (one per worker thread). A mutex is only used to park a worker thread that has nothing to do.
+*/
+//-----------------------------------------------------------------------------
+#ifndef SCHEDULER_H
+#define SCHEDULER_H
+
+/* -- Includes ------------------------------------------------------------ */
+#include <stddef.h>
+#include <atomic>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+#include <vector>
+#include "observable.h"
+
+
+/* -- Defines ------------------------------------------------------------- */
+#define CACHE_LINE_SIZE 64
+
+
+/* -- Types --------------------------------------------------------------- */
+
+//bounded, lock-free ring queue for exactly one producer thread and one consumer thread.
+//(the consumer may change, as long as there is never more than one at a time)
+template <typename T>
+class SpscQueue
+{
+public:
+   //capacity is rounded up to a power of two
+   explicit SpscQueue(size_t capacity)
+   {
+      size_t size = 2;
+      while (size < capacity) size *= 2;
+      this->mask = size - 1;
+      this->items = new T[size];
+      this->head = 0;
+      this->tail = 0;
+      this->cachedHead = 0;
+      this->cachedTail = 0;
+   }
+
+   ~SpscQueue()
+   {
+      delete[] items;
+   }
+
+   //producer side. returns false if the queue is full
+   bool push(T const & item)
+   {
+      size_t t = tail.load(std::memory_order_relaxed);
+      if (t - cachedHead > mask) //looks full - get the actual head
+      {
+         cachedHead = head.load(std::memory_order_acquire);
+         if (t - cachedHead > mask) return false;
+      }
+      items[t & mask] = item;
+      tail.store(t + 1, std::memory_order_release);
+      return true;
+   }
+
+   //consumer side. returns false if the queue is empty
+   bool pop(T & item)
+   {
+      size_t h = head.load(std::memory_order_relaxed);
+      if (h == cachedTail) //looks empty - get the actual tail
+      {
+         cachedTail = tail.load(std::memory_order_acquire);
+         if (h == cachedTail) return false;
+      }
+      item = items[h & mask];
+      head.store(h + 1, std::memory_order_release);
+      return true;
+   }
+
+   bool empty() const
+   {
+      return head.load(std::memory_order_acquire) == tail.load(std::memory_order_acquire);
+   }
+
+private:
+   SpscQueue(SpscQueue const &);
+   SpscQueue & operator=(SpscQueue const &);
+
+   T * items;
+   size_t mask;
+   //producer and consumer data are kept on separate cache lines (to avoid false sharing)
+   alignas(CACHE_LINE_SIZE) std::atomic<size_t> tail;
+   size_t cachedHead; //producer's copy of "head"
+   alignas(CACHE_LINE_SIZE) std::atomic<size_t> head;
+   size_t cachedTail; //consumer's copy of "tail"
+};
+
+
+
+//bounded, lock-free queue for many producer threads and one consumer thread.
+//(Dmitry Vyukov's bounded queue: each cell has a sequence number, that tells whether it is free or filled)
+template <typename T>
+class MpscQueue
+{
+public:
+   //capacity is rounded up to a power of two
+   explicit MpscQueue(size_t capacity)
+   {
+      size_t size = 2;
+      while (size < capacity) size *= 2;
+      this->mask = size - 1;
+      this->cells = new Cell[size];
+      for (size_t i = 0; i < size; i++) cells[i].sequence.store(i, std::memory_order_relaxed);
+      this->tail = 0;
+      this->head = 0;
+   }
+
+   ~MpscQueue()
+   {
+      delete[] cells;
+   }
+
+   //producer side (any thread). returns false if the queue is full
+   bool push(T const & item)
+   {
+      size_t t = tail.load(std::memory_order_relaxed);
+      for (;;)
+      {
+         Cell & cell = cells[t & mask];
+         size_t sequence = cell.sequence.load(std::memory_order_acquire);
+         intptr_t diff = (intptr_t)sequence - (intptr_t)t;
+         if (diff == 0) //cell is free - try to claim it
+         {
+            if (tail.compare_exchange_weak(t, t + 1, std::memory_order_relaxed))
+            {
+               cell.item = item;
+               cell.sequence.store(t + 1, std::memory_order_release); //mark as filled
+               return true;
+            }
+         }
+         else if (diff < 0) //cell is still filled - queue is full
+         {
+            return false;
+         }
+         else //another producer was faster
+         {
+            t = tail.load(std::memory_order_relaxed);
+         }
+      }
+   }
+
+   //consumer side (one thread at a time). returns false if the queue is empty
+   bool pop(T & item)
+   {
+      size_t h = head.load(std::memory_order_relaxed);
+      Cell & cell = cells[h & mask];
+      size_t sequence = cell.sequence.load(std::memory_order_acquire);
+      if (sequence != h + 1) return false; //not filled (yet)
+      item = cell.item;
+      cell.sequence.store(h + mask + 1, std::memory_order_release); //mark as free (for the next round)
+      head.store(h + 1, std::memory_order_relaxed);
+      return true;
+   }
+
+   bool empty() const
+   {
+      size_t h = head.load(std::memory_order_relaxed);
+      return cells[h & mask].sequence.load(std::memory_order_acquire) != h + 1;
+   }
+
+   //number of queued items (just a snapshot, e.g. for statistics)
+   size_t size() const
+   {
+      size_t h = head.load(std::memory_order_relaxed);
+      size_t t = tail.load(std::memory_order_relaxed);
+      return (t > h) ? (t - h) : 0;
+   }
+
+private:
+   MpscQueue(MpscQueue const &);
+   MpscQueue & operator=(MpscQueue const &);
+
+   struct Cell
+   {
+      std::atomic<size_t> sequence;
+      T item;
+   };
+
+   Cell * cells;
+   size_t mask;
+   alignas(CACHE_LINE_SIZE) std::atomic<size_t> tail;
+   alignas(CACHE_LINE_SIZE) std::atomic<size_t> head;
+};
+
+
+
+//a fixed number of worker threads, each with its own task queue.
+//tasks are distributed round robin. a worker with nothing to do parks on a condition variable.
+class ThreadPool : public Executor
+{
+public:
+   //"threads" = 0 means one thread per core
+   explicit ThreadPool(size_t threads = 0, size_t queueCapacity = 1024)
+   {
+      if (threads == 0) threads = std::thread::hardware_concurrency();
+      if (threads == 0) threads = 1;
+      this->stopping = false;
+      this->nextWorker = 0;
+      for (size_t i = 0; i < threads; i++) workers.push_back(new Worker(queueCapacity));
+      for (size_t i = 0; i < threads; i++) workers[i]->thread = std::thread(&ThreadPool::work, this, workers[i]);
+   }
+
+   //stops the worker threads. tasks that are still queued get run (by the calling thread, if need be)
+   ~ThreadPool()
+   {
+      stopping.store(true);
+      for (size_t i = 0; i < workers.size(); i++) wake(workers[i]);
+      for (size_t i = 0; i < workers.size(); i++) workers[i]->thread.join();
+      //a task may have queued another task after the worker thread had already stopped
+      Task task;
+      bool found = true;
+      while (found)
+      {
+         found = false;
+         for (size_t i = 0; i < workers.size(); i++)
+         {
+            while (workers[i]->queue.pop(task))
+            {
+               task.run(task.context);
+               found = true;
+            }
+         }
+      }
+      for (size_t i = 0; i < workers.size(); i++) delete workers[i];
+   }
+
+   void execute(Task task)
+   {
+      size_t n = workers.size();
+      size_t first = nextWorker.fetch_add(1, std::memory_order_relaxed);
+      for (;;)
+      {
+         //try the next worker in turn. if its queue is full, try the others
+         for (size_t i = 0; i < n; i++)
+         {
+            Worker * worker = workers[(first + i) % n];
+            if (worker->queue.push(task))
+            {
+               wake(worker);
+               return;
+            }
+         }
+         std::this_thread::yield(); //all queues are full
+      }
+   }
+
+   size_t threads() const
+   {
+      return workers.size();
+   }
+
+private:
+   ThreadPool(ThreadPool const &);
+   ThreadPool & operator=(ThreadPool const &);
+
+   struct Worker
+   {
+      explicit Worker(size_t capacity) : queue(capacity), sleeping(false) { }
+
+      MpscQueue<Task> queue;
+      std::atomic<bool> sleeping;
+      std::mutex mutex; //only used to park and wake
+      std::condition_variable wakeup;
+      std::thread thread;
+   };
+
+   std::vector<Worker *> workers;
+   std::atomic<size_t> nextWorker;
+   std::atomic<bool> stopping;
+
+
+   void wake(Worker * worker)
+   {
+      std::atomic_thread_fence(std::memory_order_seq_cst); //pairs with the fence in "work"
+      if (worker->sleeping.load(std::memory_order_relaxed))
+      {
+         std::lock_guard<std::mutex> lock(worker->mutex);
+         worker->sleeping.store(false, std::memory_order_relaxed);
+         worker->wakeup.notify_one();
+      }
+   }
+
+   void work(Worker * worker)
+   {
+      Task task;
+      for (;;)
+      {
+         if (worker->queue.pop(task))
+         {
+            task.run(task.context);
+            continue;
+         }
+         //nothing to do. spin a little, before parking
+         bool found = false;
+         for (int spin = 0; (spin < 64) && !found; spin++)
+         {
+            std::this_thread::yield();
+            found = !worker->queue.empty();
+         }
+         if (found) continue;
+         if (stopping.load()) return; //queue is empty and the pool stops
+         worker->sleeping.store(true, std::memory_order_relaxed);
+         std::atomic_thread_fence(std::memory_order_seq_cst); //pairs with the fence in "wake"
+         if (!worker->queue.empty() || stopping.load())
+         {
+            worker->sleeping.store(false, std::memory_order_relaxed);
+            continue;
+         }
+         std::unique_lock<std::mutex> lock(worker->mutex);
+         while (worker->sleeping.load(std::memory_order_relaxed)) worker->wakeup.wait(lock);
+      }
+   }
+};
+
+
+
+//executor, with a dedicated thread that runs the tasks one after the other
+class ThreadExecutor : public ThreadPool
+{
+public:
+   explicit ThreadExecutor(size_t queueCapacity = 1024) : ThreadPool(1, queueCapacity) { }
+};
+
+
+
+//executor, that runs the tasks immediately (on the calling thread)
+class InlineExecutor : public Executor
+{
+public:
+   void execute(Task task)
+   {
+      task.run(task.context);
+   }
+};
+
+
+
+//mapping observer, that delivers the notifications (next, error and complete) to "observer" by means of an executor.
+//the order of the notifications is preserved: the notifications are queued and there is never more than one
+//task (that delivers them) at a time. if the queue is full, the upstream (producer) waits. (a demand-aware upstream
+//never fills it: it gets only as many values requested, as there is room for. error/complete have a slot of their own)
+template <typename V, typename E>
+class ObserveOnObserver : public MappingObserver<V,E>
+{
+public:
+   ObserveOnObserver(Executor & executor, size_t queueCapacity = 4096) : executor(executor), queue(queueCapacity + 1)
+   {
+      this->capacity = queueCapacity;
+      this->pending = 0;
+      this->released = 0;
+      this->requesting = 0;
+      this->finished = 0;
+   }
+
+   //request as many values as fit into the queue. each delivered value is replaced by another request.
+   //so a demand-aware upstream never fills the queue up (and the producer never has to wait)
+   void start(Subscription * subscription)
+   {
+      this->subscription = subscription;
+      subscription->request(capacity);
+   }
+
+   //the observer gets the values at the pace of the executor. its demand isn't passed on
+   void request(size_t)
+   {
+   }
+
+   void next(V const & value)
+   {
+      Notification notification;
+      notification.kind = Notification::Next;
+      notification.value = value;
+      push(notification);
+   }
+
+   void nextBatch(V const * values, size_t count)
+   {
+      Notification notification;
+      notification.kind = Notification::Next;
+      for (size_t i = 0; (i < count) && !this->isUnsubscribed(); i++)
+      {
+         notification.value = values[i];
+         push(notification);
+      }
+   }
+
+   void error(E const & err)
+   {
+      Notification notification;
+      notification.kind = Notification::Error;
+      notification.err = err;
+      push(notification);
+   }
+
+   void complete()
+   {
+      Notification notification;
+      notification.kind = Notification::Complete;
+      push(notification);
+      finished.fetch_add(1, std::memory_order_release); //the producer is done (and won't touch "this" anymore)
+   }
+
+   //true, once "complete" was delivered to the observer (then the operator may be destroyed)
+   bool isTerminated() const
+   {
+      //both, producer and consumer are done - and there is no request task left
+      return (finished.load(std::memory_order_acquire) == 2) && (requesting.load(std::memory_order_acquire) == 0);
+   }
+
+private:
+   struct Notification
+   {
+      enum Kind { Next, Error, Complete } kind;
+      V value;
+      E err;
+   };
+
+   static const size_t DRAIN_LIMIT = 1024; //max. number of notifications delivered by one task (fairness)
+
+   Executor & executor;
+   SpscQueue<Notification> queue; //(one more slot, than values are requested: for error/complete)
+   size_t capacity;
+   std::atomic<size_t> pending; //number of pushed notifications, the delivering task hasn't accounted for yet
+   std::atomic<size_t> released; //number of delivered values, that haven't been requested again yet
+   std::atomic<size_t> requesting; //number of request tasks, that haven't finished yet
+   std::atomic<int> finished; //incremented by the producer (after pushing "complete") and by the consumer (after delivering it)
+
+
+   void push(Notification const & notification)
+   {
+      while (!queue.push(notification)) std::this_thread::yield(); //queue is full. wait for the consumer
+      if (pending.fetch_add(1, std::memory_order_acq_rel) == 0) //schedule a task, if there isn't one already
+      {
+         Task task = { &ObserveOnObserver::drain, this };
+         executor.execute(task);
+      }
+   }
+
+   //the task, that delivers the queued notifications to the observer
+   static void drain(void * context)
+   {
+      ObserveOnObserver * thiz = (ObserveOnObserver *)context;
+      V values[64]; //consecutive "next" values are delivered as batch
+      size_t n = 0;
+      size_t delivered = 0;
+      size_t consumed = 0; //number of delivered "next" values (to be requested again)
+      bool completed = false;
+      Notification notification;
+      for (;;)
+      {
+         while ((delivered < DRAIN_LIMIT) && !completed && thiz->queue.pop(notification))
+         {
+            delivered++;
+            if (notification.kind == Notification::Next) consumed++;
+            if (thiz->isUnsubscribed()) continue; //drop everything, once unsubscribed
+            if (notification.kind == Notification::Next)
+            {
+               values[n++] = notification.value;
+               if (n == 64)
+               {
+                  thiz->observer->nextBatch(values, n);
+                  n = 0;
+               }
+               continue;
+            }
+            if (n > 0)
+            {
+               thiz->observer->nextBatch(values, n);
+               n = 0;
+               if (thiz->isUnsubscribed()) continue; //unsubscribed by the batch
+            }
+            if (notification.kind == Notification::Error) thiz->observer->error(notification.err);
+            else
+            {
+               thiz->observer->complete();
+               completed = true; //nothing may follow
+            }
+         }
+         if (n > 0)
+         {
+            thiz->observer->nextBatch(values, n);
+            n = 0;
+         }
+         if (completed)
+         {
+            thiz->finished.fetch_add(1, std::memory_order_release); //"thiz" must not be touched afterwards
+            return;
+         }
+         if (consumed > 0) //there is room in the queue again
+         {
+            thiz->requestAgain(consumed);
+            consumed = 0;
+         }
+         //account for the delivered notifications. if nothing was pushed in the meantime, the task ends here.
+         //(otherwise the producer relies on this task to deliver the new ones)
+         size_t accounted = delivered;
+         delivered = 0;
+         if (thiz->pending.fetch_sub(accounted, std::memory_order_acq_rel) == accounted) return;
+         if (accounted >= DRAIN_LIMIT) //give other tasks a chance - and continue later
+         {
+            Task task = { &ObserveOnObserver::drain, thiz };
+            thiz->executor.execute(task);
+            return;
+         }
+      }
+   }
+
+   //request the delivered values again - by a task of its own. (a request may make the upstream emit right away,
+   //on the calling thread. within "drain", that would be the consumer pushing into its own queue)
+   void requestAgain(size_t n)
+   {
+      if (released.fetch_add(n, std::memory_order_acq_rel) > 0) return; //there is a request task already
+      requesting.fetch_add(1, std::memory_order_acq_rel);
+      Task task = { &ObserveOnObserver::requestReleased, this };
+      executor.execute(task);
+   }
+
+   static void requestReleased(void * context)
+   {
+      ObserveOnObserver * thiz = (ObserveOnObserver *)context;
+      size_t n = thiz->released.exchange(0, std::memory_order_acq_rel);
+      if ((n > 0) && !thiz->isUnsubscribed()) thiz->subscription->request(n);
+      thiz->requesting.fetch_sub(1, std::memory_order_release); //"thiz" must not be touched afterwards
+   }
+};
+
+#endif
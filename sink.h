@@ -0,0 +1,332 @@
+//-----------------------------------------------------------------------------
+/*!
+   \file
+   \brief A buffered sink: an observer, that writes the values it gets to a file descriptor.
+
+   The demo observers print each value by "cout << value << endl" - "endl" flushes the stream, so each value
+   costs a system call. The WriteSink formats the values into a buffer instead (allocated once) and writes the
+   buffer, when it is full, when the oldest buffered value is older than "maxDelay" or on complete/error.
+   So many values are written by one system call.
+
+      WriteSink<int, char const *> sink(STDOUT_FILENO); //one value per line
+      observable->subscribe(sink);
+
+   The values are formatted by SinkFormat<V>: integers and floating point numbers by std::to_chars (no locale, no
+   allocation), texts (char const *, std::string, std::string_view) are copied as they are. A text, that doesn't fit
+   into the buffer, isn't copied at all: it is written together with the buffer (writev). SinkFormat may be
+   specialized for other types.
+   The delay is checked, when values arrive (there is no timer). So call "flush" (e.g. periodically), if the last
+   values shall not wait for further ones.
+
+   If writing fails, the sink unsubscribes from the observable (the error code is kept: see "writeError").
+*/
+//-----------------------------------------------------------------------------
+#ifndef SINK_H
+#define SINK_H
+
+#if __cplusplus < 201703L
+#error "sink.h needs C++17 (std::string_view, std::to_chars): compile with -std=c++17"
+#endif
+
+/* -- Includes ------------------------------------------------------------ */
+#include <stddef.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
+#include <sys/uio.h>
+#include <charconv>
+#include <chrono>
+#include <new>
+#include <string>
+#include <string_view>
+#include <type_traits>
+#include "observable.h"
+
+
+/* -- Types --------------------------------------------------------------- */
+
+//how the values of type T are written. TEXT types provide "text" - all others "write" (at most MAX_SIZE chars)
+template <typename T, typename Enable = void>
+struct SinkFormat; //(not defined: there is no format for T)
+
+template <typename T>
+struct SinkFormat<T, typename std::enable_if<std::is_integral<T>::value && !std::is_same<T, bool>::value>::type>
+{
+   static const bool TEXT = false;
+   static const size_t MAX_SIZE = 40; //(enough for 128 bits)
+
+   static char * write(char * out, T value)
+   {
+      return std::to_chars(out, out + MAX_SIZE, value).ptr;
+   }
+};
+
+template <typename T>
+struct SinkFormat<T, typename std::enable_if<std::is_floating_point<T>::value>::type>
+{
+   static const bool TEXT = false;
+   static const size_t MAX_SIZE = 64;
+
+   //(the shortest representation, that reads back to the same value)
+   static char * write(char * out, T value)
+   {
+      return std::to_chars(out, out + MAX_SIZE, value).ptr;
+   }
+};
+
+template <>
+struct SinkFormat<bool>
+{
+   static const bool TEXT = false;
+   static const size_t MAX_SIZE = 5;
+
+   static char * write(char * out, bool value)
+   {
+      if (value)
+      {
+         memcpy(out, "true", 4);
+         return out + 4;
+      }
+      memcpy(out, "false", 5);
+      return out + 5;
+   }
+};
+
+template <>
+struct SinkFormat<char const *>
+{
+   static const bool TEXT = true;
+
+   static std::string_view text(char const * value)
+   {
+      return (value != nullptr) ? std::string_view(value) : std::string_view("(null)");
+   }
+};
+
+template <>
+struct SinkFormat<char *> : SinkFormat<char const *> { };
+
+template <>
+struct SinkFormat<std::string_view>
+{
+   static const bool TEXT = true;
+
+   static std::string_view text(std::string_view value)
+   {
+      return value;
+   }
+};
+
+template <>
+struct SinkFormat<std::string>
+{
+   static const bool TEXT = true;
+
+   static std::string_view text(std::string const & value)
+   {
+      return value;
+   }
+};
+
+
+
+template <typename V, typename E>
+class WriteSink : public Observer<V,E>
+{
+public:
+   //"capacity": size of the buffer (the size threshold). "maxDelay": a value is written at the latest, when
+   //values arrive this long after it (0: no time threshold). each value is followed by "separator"
+   explicit WriteSink(int fd, size_t capacity = 64 * 1024, std::chrono::nanoseconds maxDelay = std::chrono::nanoseconds(0),
+                      char separator = '\n')
+   {
+      this->fd = fd;
+      this->capacity = (capacity >= MIN_CAPACITY) ? capacity : MIN_CAPACITY;
+      this->buffer = (char *)malloc(this->capacity);
+      if (this->buffer == nullptr) throw std::bad_alloc();
+      this->used = 0;
+      this->maxDelay = (int64_t)maxDelay.count();
+      this->pendingSince = 0;
+      this->sinceCheck = 0;
+      this->separator = separator;
+      this->written = 0;
+      this->writes = 0;
+      this->errorNumber = 0;
+   }
+
+   ~WriteSink()
+   {
+      flush();
+      free(buffer);
+   }
+
+   void next(V const & value)
+   {
+      append(value);
+      if (++sinceCheck >= CHECK_INTERVAL) checkDelay();
+   }
+
+   void nextBatch(V const * values, size_t count)
+   {
+      for (size_t i = 0; (i < count) && !this->isUnsubscribed(); i++) append(values[i]);
+      checkDelay();
+   }
+
+   //the error is written as a line of its own ("error: ..."), if there is a SinkFormat for E
+   void error(E const & err)
+   {
+      appendError(err, 0);
+      flush();
+   }
+
+   void complete()
+   {
+      flush();
+   }
+
+   //write the buffered values now
+   void flush()
+   {
+      if (used == 0) return;
+      struct iovec iov = { buffer, used };
+      writeAll(&iov, 1);
+      used = 0;
+   }
+
+   //number of bytes written (so far)
+   uint64_t bytesWritten() const
+   {
+      return written;
+   }
+
+   //number of system calls, that were needed to write them
+   uint64_t writeCalls() const
+   {
+      return writes;
+   }
+
+   //errno of the write, that has failed (0: none)
+   int writeError() const
+   {
+      return errorNumber;
+   }
+
+private:
+   static const size_t MIN_CAPACITY = 256;
+   static const size_t CHECK_INTERVAL = 64; //values passed to "next", after which the delay is checked
+
+   int fd;
+   char * buffer;
+   size_t capacity;
+   size_t used;
+   int64_t maxDelay; //ns
+   int64_t pendingSince; //time (ns), the oldest buffered value was buffered
+   size_t sinceCheck; //values passed to "next" since the delay was checked
+   char separator;
+   uint64_t written;
+   uint64_t writes;
+   int errorNumber;
+
+   //copying makes no sense (the buffer would be shared)
+   WriteSink(WriteSink const &);
+   WriteSink & operator=(WriteSink const &);
+
+
+   static int64_t now()
+   {
+      return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+   }
+
+   //(the time is taken only for the first value after a flush)
+   void buffering()
+   {
+      if ((used == 0) && (maxDelay > 0)) pendingSince = now();
+   }
+
+   void checkDelay()
+   {
+      sinceCheck = 0;
+      if ((used > 0) && (maxDelay > 0) && ((now() - pendingSince) >= maxDelay)) flush();
+   }
+
+   template <typename T>
+   void append(T const & value)
+   {
+      if constexpr (SinkFormat<T>::TEXT) appendText(SinkFormat<T>::text(value), true);
+      else
+      {
+         if ((capacity - used) < (SinkFormat<T>::MAX_SIZE + 1)) flush();
+         buffering();
+         char * end = SinkFormat<T>::write(buffer + used, value);
+         *end++ = separator;
+         used = (size_t)(end - buffer);
+      }
+   }
+
+   void appendText(std::string_view text, bool separate)
+   {
+      size_t size = text.size() + (separate ? 1 : 0);
+      if ((capacity - used) < size)
+      {
+         if (size > (capacity / 2)) //a large text: write it along with the buffer - without copying it
+         {
+            struct iovec iov[3] = { { buffer, used }, { (void *)text.data(), text.size() }, { &separator, separate ? 1u : 0u } };
+            writeAll(iov, 3);
+            used = 0;
+            return;
+         }
+         flush();
+      }
+      buffering();
+      memcpy(buffer + used, text.data(), text.size());
+      used += text.size();
+      if (separate) buffer[used++] = separator;
+   }
+
+   template <typename Err>
+   auto appendError(Err const & err, int) -> decltype(SinkFormat<Err>::TEXT, void())
+   {
+      appendText("error: ", false);
+      append(err);
+   }
+
+   template <typename Err>
+   void appendError(Err const &, long)
+   {
+      appendText("error", true);
+   }
+
+   //write all of the given buffers (in as few calls as possible). if it fails, stop the upstream
+   void writeAll(struct iovec * iov, int count)
+   {
+      while ((count > 0) && (errorNumber == 0))
+      {
+         ssize_t n = writev(fd, iov, count);
+         if (n < 0)
+         {
+            if (errno == EINTR) continue;
+            errorNumber = errno;
+            if (this->subscription != nullptr) this->subscription->unsubscribe();
+            return;
+         }
+         writes++;
+         written += (uint64_t)n;
+         //skip what has been written (a write may be partial)
+         size_t rest = (size_t)n;
+         while ((count > 0) && (rest >= iov->iov_len))
+         {
+            rest -= iov->iov_len;
+            iov++;
+            count--;
+         }
+         if (count > 0)
+         {
+            iov->iov_base = (char *)iov->iov_base + rest;
+            iov->iov_len -= rest;
+         }
+      }
+   }
+};
+
+#endif
@@ -0,0 +1,273 @@
+//-----------------------------------------------------------------------------
+/*!
+   \file
+   \brief Splits a stream of bytes into records (e.g. the lines of a text log).
+
+   "split" subscribes to an observable of chars - e.g. "from" a buffer, or "fromMappedFile<char, E>" - and
+   emits the records between the delimiters as std::string_view. The views point into the bytes of the
+   upstream batch. Nothing is copied - except a record, that spans two (or more) batches of the upstream:
+   its beginning is kept in a buffer, until the rest of it arrives. A trailing record without delimiter is
+   emitted on complete. (the delimiter itself isn't part of the record)
+
+      Observable<std::string_view, char const *> * lines =
+         split(fromMappedFile<char, char const *>("server.log"), '\n');
+      lines->subscribe(lineObserver);
+
+   The delimiters are searched using SIMD instructions (the instruction set is chosen at runtime, see numeric.h).
+
+   As the views point into the upstream batch, they are valid only within "next" / "nextBatch". An observer,
+   that wants to keep a record, has to copy it.
+   The splitter isn't demand-aware: the number of records in a batch of bytes isn't known in advance. So it
+   requests all bytes of its upstream (just like a subject, use the BackpressureObserver, if necessary).
+*/
+//-----------------------------------------------------------------------------
+#ifndef SPLITTER_H
+#define SPLITTER_H
+
+#if __cplusplus < 201703L
+#error "splitter.h needs C++17 (std::string_view): compile with -std=c++17"
+#endif
+
+/* -- Includes ------------------------------------------------------------ */
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+#include <atomic>
+#include <string>
+#include <string_view>
+#include "arena.h"
+#include "observable.h"
+#include "numeric.h"
+
+
+/* -- Types --------------------------------------------------------------- */
+
+namespace simd
+{
+
+namespace scalar
+{
+   //index of the first "byte" in "data" - or "count" if there is none
+   inline size_t findByte(char const * data, size_t count, char byte)
+   {
+      void const * found = memchr(data, byte, count);
+      return (found == nullptr) ? count : (size_t)((char const *)found - data);
+   }
+}
+
+#if SIMD_X86
+namespace sse42
+{
+   __attribute__((target("sse4.2")))
+   inline size_t findByte(char const * data, size_t count, char byte)
+   {
+      __m128i b = _mm_set1_epi8(byte);
+      size_t i = 0;
+      for (; i + 16 <= count; i += 16)
+      {
+         __m128i v = _mm_loadu_si128((__m128i const *)(data + i));
+         int mask = _mm_movemask_epi8(_mm_cmpeq_epi8(v, b));
+         if (mask != 0) return i + __builtin_ctz(mask);
+      }
+      return i + scalar::findByte(data + i, count - i, byte);
+   }
+}
+
+namespace avx2
+{
+   //two vectors per iteration: the comparisons are or-ed, so there is only one branch per 64 bytes
+   __attribute__((target("avx2")))
+   inline size_t findByte(char const * data, size_t count, char byte)
+   {
+      __m256i b = _mm256_set1_epi8(byte);
+      size_t i = 0;
+      for (; i + 64 <= count; i += 64)
+      {
+         __m256i lo = _mm256_cmpeq_epi8(_mm256_loadu_si256((__m256i const *)(data + i)), b);
+         __m256i hi = _mm256_cmpeq_epi8(_mm256_loadu_si256((__m256i const *)(data + i + 32)), b);
+         if (_mm256_testz_si256(_mm256_or_si256(lo, hi), _mm256_or_si256(lo, hi))) continue;
+         uint32_t mask = (uint32_t)_mm256_movemask_epi8(lo);
+         if (mask != 0) return i + __builtin_ctz(mask);
+         return i + 32 + __builtin_ctz((uint32_t)_mm256_movemask_epi8(hi));
+      }
+      for (; i + 32 <= count; i += 32)
+      {
+         uint32_t mask = (uint32_t)_mm256_movemask_epi8(_mm256_cmpeq_epi8(_mm256_loadu_si256((__m256i const *)(data + i)), b));
+         if (mask != 0) return i + __builtin_ctz(mask);
+      }
+      return i + scalar::findByte(data + i, count - i, byte);
+   }
+}
+#endif //SIMD_X86
+
+
+//index of the first "byte" in "data" - or "count" if there is none
+inline size_t findByte(char const * data, size_t count, char byte)
+{
+#if SIMD_X86
+   switch (level())
+   {
+   case AVX2: return avx2::findByte(data, count, byte);
+   case SSE42: return sse42::findByte(data, count, byte);
+   default: break;
+   }
+#endif
+   return scalar::findByte(data, count, byte);
+}
+
+} //namespace simd
+
+
+
+//observable constructed using "split"
+template <typename E>
+class ObservableSplit : public Observable<std::string_view,E>
+{
+public:
+   //create the observable - either on the heap or (if given) in the arena
+   static ObservableSplit * construct(Observable<char,E> * source, char delimiter, ObservableArena * arena)
+   {
+      ObservableSplit * thiz = (arena == nullptr) ? new ObservableSplit() : arena->make<ObservableSplit>();
+      thiz->source = source;
+      thiz->delimiter = delimiter;
+      return thiz;
+   }
+
+private:
+   static const size_t CHUNK = 64; //max. number of records passed at once to "nextBatch"
+
+   //subscribes to the source observable, splits its bytes and passes the records on to the observer
+   class Splitter : public Observer<char,E>
+   {
+   public:
+      ObservableSplit * node;
+
+      void start(Subscription * subscription)
+      {
+         this->subscription = subscription;
+         node->upstream.store(subscription);
+         if (node->closed.load()) subscription->unsubscribe(); //unsubscribed (by another thread) in the meantime
+         else subscription->request(Subscription::UNBOUNDED);
+      }
+
+      void next(char const & byte)
+      {
+         nextBatch(&byte, 1);
+      }
+
+      void nextBatch(char const * data, size_t count)
+      {
+         char delimiter = node->delimiter;
+         std::string & carry = node->carry;
+         if (node->carrying) //the beginning of the current record came with a previous batch
+         {
+            size_t end = simd::findByte(data, count, delimiter);
+            carry.append(data, end);
+            if (end == count) return; //the record goes on in the next batch
+            node->carrying = false;
+            node->observer->next(std::string_view(carry.data(), carry.size()));
+            carry.clear();
+            data += end + 1;
+            count -= end + 1;
+         }
+         std::string_view records[CHUNK];
+         size_t n = 0;
+         while ((count > 0) && !this->isUnsubscribed())
+         {
+            size_t end = simd::findByte(data, count, delimiter);
+            if (end == count) //no delimiter: keep the beginning of the record, until the rest of it arrives
+            {
+               carry.assign(data, count);
+               node->carrying = true;
+               break;
+            }
+            records[n++] = std::string_view(data, end);
+            if (n == CHUNK)
+            {
+               node->observer->nextBatch(records, n);
+               n = 0;
+            }
+            data += end + 1;
+            count -= end + 1;
+         }
+         if ((n > 0) && !this->isUnsubscribed()) node->observer->nextBatch(records, n);
+      }
+
+      void error(E const & err)
+      {
+         node->observer->error(err);
+      }
+
+      void complete()
+      {
+         if (node->carrying && !this->isUnsubscribed()) //the last record has no delimiter
+         {
+            node->carrying = false;
+            node->observer->next(std::string_view(node->carry.data(), node->carry.size()));
+         }
+         node->carry = std::string(); //free the memory
+         node->observer->complete();
+      }
+   };
+
+   Observable<char,E> * source;
+   Observer<std::string_view,E> * observer;
+   Splitter splitter;
+   char delimiter;
+   bool carrying; //"carry" holds the beginning of a record, that spans batches
+   std::string carry;
+   std::atomic<Subscription *> upstream; //the subscription of the source observable (once it has started)
+
+   friend class ObservableArena;
+
+   ObservableSplit() : upstream(nullptr)
+   {
+      this->subscribeHandler = static_cast<typename Observable<std::string_view,E>::SubscribeHandler>(&ObservableSplit::subscribeHandler_split);
+      this->source = nullptr;
+      this->observer = nullptr;
+      this->splitter.node = this;
+      this->delimiter = '\n';
+      this->carrying = false;
+   }
+
+   //this is the method that is called when someone subscribes to the observable that was constructed using "split"
+   Subscription * subscribeHandler_split(Observer<std::string_view,E> * observer)
+   {
+      //prevent further invocation (there is only room for one observer)
+      this->subscribeHandler = nullptr;
+      this->observer = observer;
+      observer->start(this);
+      Task task = { &ObservableSplit::subscribeSource, this };
+      Trampoline::schedule(task);
+      return this;
+   }
+
+   static void subscribeSource(void * context)
+   {
+      ObservableSplit * thiz = (ObservableSplit *)context;
+      if (thiz->isClosed()) return; //unsubscribed in the meantime
+      thiz->source->subscribe(thiz->splitter);
+   }
+
+   void unsubscribe()
+   {
+      if (this->closed.exchange(true)) return; //passed on already
+      Observable<std::string_view,E>::unsubscribe();
+      //pass on to the source observable (to stop its emission). if it hasn't started yet, the splitter does so on start
+      Subscription * subscription = upstream.load();
+      if (subscription != nullptr) subscription->unsubscribe();
+   }
+};
+
+
+
+/* -- Factory functions --------------------------------------------------- */
+
+//construct an observable, that emits the records of the given stream of bytes, separated by "delimiter"
+template <typename E>
+Observable<std::string_view,E> * split(Observable<char,E> * source, char delimiter = '\n', ObservableArena * arena = nullptr)
+{
+   return ObservableSplit<E>::construct(source, delimiter, arena);
+}
+
+#endif
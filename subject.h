@@ -0,0 +1,594 @@
+//-----------------------------------------------------------------------------
+/*!
+   \file
+   \brief A multicasting Subject.
+
+   An observable drives exactly one observer per emission. To fan out one producer to many consumers, the
+   source would have to be run once per consumer. A Subject is both: an observer (subscribe it to the
+   source) and an observable (subscribe as many observers to it as needed). Each value it gets, is passed on
+   to all of its subscribers.
+
+      Subject<int, char const *> subject;
+      subject.subscribe(observerA);
+      subject.subscribe(observerB);
+      IntObservable::from(values, count)->subscribe(subject); //observerA and observerB get all the values
+
+   The subscribers are kept in an array, that is never modified once published ("copy on write"). "subscribe"
+   and "unsubscribe" (which may be called from any thread) build a new array and publish it atomically.
+   "next" just loads the current array and walks it - no lock at all on the emit path. An old array is freed,
+   once no emission uses it any more (read-copy-update: the emissions are counted, see ReadCopyUpdate).
+
+   Each subscriber gets a subscription of its own. Unsubscribing from it, removes just this subscriber.
+   The subscriptions live as long as the subject: the observers downstream (e.g. of a "map") keep using theirs
+   (isUnsubscribed, request) after the unsubscribe - there is no point in time, they are done with it.
+
+   A subscriber that joins late, misses the values emitted before. The ReplaySubject keeps the last N values
+   (and/or the values of the last T nanoseconds) in a ring buffer, that is allocated once at construction.
+   A new subscriber gets them as (at most two) batches, before it gets the values that follow. The
+   BehaviorSubject keeps just the latest value (starting with an initial one).
+   A subject is "hot": it passes on what it gets, no matter what its subscribers have requested. That holds for
+   the replayed values as well. A subscriber, that needs backpressure, is subscribed through a
+   BackpressureObserver (see backpressure.h).
+
+      ReplaySubject<int, char const *> lastHundred(100);
+      BehaviorSubject<int, char const *> state(0);
+*/
+//-----------------------------------------------------------------------------
+#ifndef SUBJECT_H
+#define SUBJECT_H
+
+/* -- Includes ------------------------------------------------------------ */
+#include <stddef.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <atomic>
+#include <chrono>
+#include <mutex>
+#include <new>
+#include <thread>
+#include "observable.h"
+#include "scheduler.h"
+
+
+/* -- Types --------------------------------------------------------------- */
+
+//counts the readers (here: the emissions) of a published pointer, so that a writer is able to wait, until
+//nobody uses the pointer it has just replaced.
+//there are two counters: a reader increments the one of the current epoch. a writer flips the epoch (so new
+//readers use the other counter) and waits, until the counter of the old epoch drops to zero - twice.
+class ReadCopyUpdate
+{
+public:
+   ReadCopyUpdate() : epoch(0)
+   {
+      readers[0] = 0;
+      readers[1] = 0;
+   }
+
+   //enter a read section. the returned index has to be passed to "leave".
+   //(the published pointer has to be loaded after "enter", using memory_order_seq_cst)
+   unsigned enter()
+   {
+      unsigned index = epoch.load(std::memory_order_relaxed) & 1;
+      readers[index].fetch_add(1, std::memory_order_seq_cst);
+      depth()++;
+      return index;
+   }
+
+   void leave(unsigned index)
+   {
+      depth()--;
+      readers[index].fetch_sub(1, std::memory_order_release);
+   }
+
+   //wait, until all read sections, that have been entered before, are left.
+   //must not be called from within a read section (of any ReadCopyUpdate) - it would wait forever
+   void synchronize()
+   {
+      std::lock_guard<std::mutex> lock(mutex); //one writer at a time flips the epoch
+      std::atomic_thread_fence(std::memory_order_seq_cst); //the new pointer is published, before the readers are checked
+      for (int phase = 0; phase < 2; phase++)
+      {
+         unsigned index = epoch.load(std::memory_order_relaxed) & 1;
+         epoch.store(index ^ 1, std::memory_order_seq_cst);
+         while (readers[index].load(std::memory_order_acquire) != 0) std::this_thread::yield();
+      }
+   }
+
+   //true, if there is no read section right now - so all the ones, that have been entered before, are left.
+   //(unlike "synchronize", it doesn't wait)
+   bool idle()
+   {
+      std::atomic_thread_fence(std::memory_order_seq_cst); //the new pointer is published, before the readers are checked
+      return (readers[0].load(std::memory_order_acquire) == 0) && (readers[1].load(std::memory_order_acquire) == 0);
+   }
+
+   //true, if the calling thread is within a read section (of any ReadCopyUpdate)
+   static bool insideReadSection()
+   {
+      return depth() > 0;
+   }
+
+private:
+   alignas(CACHE_LINE_SIZE) std::atomic<size_t> readers[2];
+   alignas(CACHE_LINE_SIZE) std::atomic<unsigned> epoch;
+   std::mutex mutex;
+
+   //number of read sections, the calling thread is in (nested, if a subscriber emits to another subject)
+   static unsigned & depth()
+   {
+      static thread_local unsigned count = 0;
+      return count;
+   }
+};
+
+
+
+template <typename V, typename E>
+class Subject : public Observer<V,E>, public Observable<V,E>
+{
+private:
+   //the subscription of one subscriber
+   class Entry final : public Subscription
+   {
+   public:
+      Subject * subject;
+      Observer<V,E> * observer;
+      Entry * link; //all entries of the subject (to delete them, when the subject gets destroyed)
+      uint64_t replayed; //sequence number of the last value, the subscriber got replayed (see ReplaySubject)
+
+      Entry(Subject * subject, Observer<V,E> * observer)
+      {
+         this->subject = subject;
+         this->observer = observer;
+         this->link = nullptr;
+         this->replayed = 0;
+      }
+
+      void unsubscribe()
+      {
+         if (closed.exchange(true)) return; //already unsubscribed
+         subject->remove(this);
+      }
+   };
+
+   static const size_t MAX_RETIRED = 64; //max. number of replaced arrays, that a subscribe leaves to be freed later
+
+   //the (immutable) array of subscribers. an empty array is represented by nullptr
+   struct Subscribers
+   {
+      Subscribers * retired; //list of replaced arrays, that wait to be freed
+      size_t count;
+      Entry * entries[1]; //actually "count" entries
+   };
+
+
+   std::atomic<Subscribers *> subscribers; //the published array
+   ReadCopyUpdate rcu;
+   std::mutex mutex; //serializes the writers (never taken by "next")
+   Subscribers * retired;
+   size_t retiredCount; //number of arrays in "retired"
+   Entry * entries;
+   bool failed; //"error" was called
+   bool terminated; //"complete" was called
+   E err;
+
+
+   //copying a subject makes no sense
+   Subject(Subject const &);
+   Subject & operator=(Subject const &);
+
+
+   static Subscribers * allocate(size_t count)
+   {
+      Subscribers * array = (Subscribers *)malloc(sizeof(Subscribers) + ((count - 1) * sizeof(Entry *)));
+      if (array == nullptr) throw std::bad_alloc();
+      array->retired = nullptr;
+      array->count = count;
+      return array;
+   }
+
+   //replace the published array. the old one is freed by "reclaim" (mutex must be locked)
+   void publish(Subscribers * array)
+   {
+      Subscribers * old = subscribers.exchange(array, std::memory_order_seq_cst);
+      if (old != nullptr)
+      {
+         old->retired = retired;
+         retired = old;
+         retiredCount++;
+      }
+   }
+
+   //free the replaced arrays (mutex must not be locked).
+   //if called from within an emission (a subscriber unsubscribes from within "next"), waiting for the emissions
+   //to finish would wait forever. the arrays are freed later then - by the next writer or the destructor.
+   //if "wait" isn't set, they are freed only if no emission is running right now (unless too many have piled up)
+   void reclaim(bool wait = true)
+   {
+      if (ReadCopyUpdate::insideReadSection()) return;
+      std::unique_lock<std::mutex> lock(mutex);
+      if (retired == nullptr) return;
+      bool idle = rcu.idle(); //nobody uses the replaced arrays any more
+      if (!wait && !idle && (retiredCount < MAX_RETIRED)) return;
+      Subscribers * list = retired;
+      retired = nullptr;
+      retiredCount = 0;
+      lock.unlock();
+      if (!idle) rcu.synchronize();
+      while (list != nullptr)
+      {
+         Subscribers * next = list->retired;
+         free(list);
+         list = next;
+      }
+   }
+
+   //remove the entry from the array of subscribers. (the entry itself is kept, until the subject gets destroyed)
+   void remove(Entry * entry)
+   {
+      std::unique_lock<std::mutex> lock(mutex);
+      Subscribers * old = subscribers.load(std::memory_order_relaxed);
+      size_t count = (old != nullptr) ? old->count : 0;
+      size_t index = 0;
+      while ((index < count) && (old->entries[index] != entry)) index++;
+      if (index == count) return; //not (or no longer) subscribed
+      Subscribers * array = nullptr;
+      if (count > 1)
+      {
+         array = allocate(count - 1);
+         for (size_t i = 0, j = 0; i < count; i++)
+         {
+            if (i != index) array->entries[j++] = old->entries[i];
+         }
+      }
+      publish(array);
+      lock.unlock();
+      reclaim();
+   }
+
+   //this is the method that is called when someone subscribes to the subject
+   Subscription * subscribeHandler_subject(Observer<V,E> * observer)
+   {
+      Entry * entry = new Entry(this, observer);
+      //pass the subscription object to the observer, before it gets any value (it may unsubscribe right away)
+      observer->start(entry);
+      //a derived subject passes the values it has stored to the new subscriber (see ReplaySubject) - over and over,
+      //until it hasn't stored a new one in the meantime. then the subscriber is added, before the lock is released.
+      //so it gets the values, that are stored from now on, as any other subscriber
+      uint64_t replayed = 0;
+      lockEmission();
+      while (!entry->isClosed() && replay(observer, replayed)) { }
+      entry->replayed = replayed;
+      std::unique_lock<std::mutex> lock(mutex);
+      entry->link = entries;
+      entries = entry;
+      bool failed = this->failed;
+      bool terminated = this->terminated;
+      if (!terminated && !entry->isClosed())
+      {
+         Subscribers * old = subscribers.load(std::memory_order_relaxed);
+         size_t count = (old != nullptr) ? old->count : 0;
+         Subscribers * array = allocate(count + 1);
+         for (size_t i = 0; i < count; i++) array->entries[i] = old->entries[i];
+         array->entries[count] = entry;
+         publish(array);
+      }
+      lock.unlock();
+      unlockEmission();
+      reclaim(false); //a subscriber doesn't wait for a (slow) emission to finish
+      //a late subscriber gets the error and/or complete right away
+      if (failed && !entry->isClosed()) observer->error(err);
+      if (terminated && !entry->isClosed()) observer->complete();
+      return entry;
+   }
+
+
+protected:
+   //the subject as a whole can't be unsubscribed. (each subscriber unsubscribes by means of its own subscription)
+   void unsubscribe()
+   {
+   }
+
+   //hooks for derived subjects, that store values (see ReplaySubject).
+   //"replay" is called for each new subscriber, while the emission is locked: it passes the stored values after the
+   //sequence number "replayed" to the observer - without holding the lock meanwhile - and updates "replayed".
+   //it returns false (and keeps the lock), if there were none
+   virtual void lockEmission() { }
+   virtual void unlockEmission() { }
+   virtual bool replay(Observer<V,E> *, uint64_t &) { return false; }
+
+   //pass the values (with the sequence numbers "first", "first + 1", ...) on to all subscribers - except for the
+   //ones, they got replayed already
+   void deliver(V const * values, size_t n, uint64_t first)
+   {
+      unsigned index = rcu.enter();
+      Subscribers * array = subscribers.load(std::memory_order_seq_cst);
+      size_t count = (array != nullptr) ? array->count : 0;
+      for (size_t i = 0; i < count; i++)
+      {
+         Entry * entry = array->entries[i];
+         size_t skip = (entry->replayed < first) ? 0 : (size_t)(entry->replayed - first + 1);
+         if ((skip >= n) || entry->isClosed()) continue;
+         if (n == 1) entry->observer->next(*values);
+         else entry->observer->nextBatch(values + skip, n - skip);
+      }
+      rcu.leave(index);
+   }
+
+
+public:
+   Subject() : subscribers(nullptr)
+   {
+      this->subscribeHandler = static_cast<typename Observable<V,E>::SubscribeHandler>(&Subject::subscribeHandler_subject);
+      this->retired = nullptr;
+      this->retiredCount = 0;
+      this->entries = nullptr;
+      this->failed = false;
+      this->terminated = false;
+   }
+
+   ~Subject()
+   {
+      publish(nullptr);
+      while (retired != nullptr)
+      {
+         Subscribers * next = retired->retired;
+         free(retired);
+         retired = next;
+      }
+      while (entries != nullptr)
+      {
+         Entry * next = entries->link;
+         delete entries;
+         entries = next;
+      }
+   }
+
+
+   //pass the value on to all subscribers
+   void next(V const & value)
+   {
+      unsigned index = rcu.enter();
+      Subscribers * array = subscribers.load(std::memory_order_seq_cst);
+      size_t count = (array != nullptr) ? array->count : 0;
+      for (size_t i = 0; i < count; i++)
+      {
+         Entry * entry = array->entries[i];
+         if (!entry->isClosed()) entry->observer->next(value);
+      }
+      rcu.leave(index);
+   }
+
+   //pass the batch on to all subscribers (as a batch)
+   void nextBatch(V const * values, size_t n)
+   {
+      unsigned index = rcu.enter();
+      Subscribers * array = subscribers.load(std::memory_order_seq_cst);
+      size_t count = (array != nullptr) ? array->count : 0;
+      for (size_t i = 0; i < count; i++)
+      {
+         Entry * entry = array->entries[i];
+         if (!entry->isClosed()) entry->observer->nextBatch(values, n);
+      }
+      rcu.leave(index);
+   }
+
+   //pass the error on to all subscribers. late subscribers get it as well
+   void error(E const & err)
+   {
+      std::unique_lock<std::mutex> lock(mutex);
+      if (failed || terminated) return;
+      this->err = err;
+      failed = true;
+      lock.unlock();
+
+      unsigned index = rcu.enter();
+      Subscribers * array = subscribers.load(std::memory_order_seq_cst);
+      size_t count = (array != nullptr) ? array->count : 0;
+      for (size_t i = 0; i < count; i++)
+      {
+         Entry * entry = array->entries[i];
+         if (!entry->isClosed()) entry->observer->error(err);
+      }
+      rcu.leave(index);
+   }
+
+   //pass the complete on to all subscribers and drop them. late subscribers get complete right away
+   void complete()
+   {
+      std::unique_lock<std::mutex> lock(mutex);
+      if (terminated) return;
+      terminated = true; //from now on, no subscriber gets added any more
+      lock.unlock();
+
+      unsigned index = rcu.enter();
+      Subscribers * array = subscribers.load(std::memory_order_seq_cst);
+      size_t count = (array != nullptr) ? array->count : 0;
+      for (size_t i = 0; i < count; i++)
+      {
+         Entry * entry = array->entries[i];
+         if (!entry->isClosed()) entry->observer->complete();
+      }
+      rcu.leave(index);
+
+      lock.lock();
+      publish(nullptr);
+      lock.unlock();
+      reclaim();
+   }
+
+   //number of subscribers (at the moment)
+   size_t subscriberCount()
+   {
+      std::lock_guard<std::mutex> lock(mutex);
+      Subscribers * array = subscribers.load(std::memory_order_relaxed);
+      return (array != nullptr) ? array->count : 0;
+   }
+};
+
+
+
+//a subject, that replays the last "capacity" values to each new subscriber (regardless of its demand).
+//if "maxAge" is given, only values that are younger are replayed.
+//the lock is held only to store a value - or to copy the stored ones for a new subscriber. the values are passed
+//on without it. so a slow subscriber doesn't hold up the emitters and new subscribers (it may even subscribe another
+//observer from within "next"). each value gets a sequence number, so a new subscriber gets each value once: either
+//replayed or passed on
+template <typename V, typename E>
+class ReplaySubject : public Subject<V,E>
+{
+private:
+   V * values; //ring buffer of the stored values
+   int64_t * times; //the time (in ns), each value was stored (only if "maxAge" is given)
+   size_t capacity;
+   size_t head; //index of the oldest stored value
+   size_t count; //number of stored values
+   int64_t maxAge;
+   uint64_t sequence; //sequence number of the newest value (= number of values stored so far)
+   std::mutex emission; //held while values are stored - or the stored ones are copied to be replayed
+
+   static int64_t now()
+   {
+      return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+   }
+
+   //store a batch of values (overwriting the oldest ones, if the buffer is full)
+   void store(V const * batch, size_t n)
+   {
+      sequence += n;
+      if (capacity == 0) return;
+      if (n > capacity) //only the last "capacity" values are of interest
+      {
+         batch += n - capacity;
+         n = capacity;
+      }
+      int64_t time = (times != nullptr) ? now() : 0;
+      size_t tail = (head + count) % capacity; //where the next value goes to
+      for (size_t i = 0; i < n; )
+      {
+         size_t chunk = capacity - tail; //up to the end of the buffer
+         if (chunk > (n - i)) chunk = n - i;
+         for (size_t j = 0; j < chunk; j++) values[tail + j] = batch[i + j];
+         if (times != nullptr) for (size_t j = 0; j < chunk; j++) times[tail + j] = time;
+         i += chunk;
+         tail = (tail + chunk) % capacity;
+      }
+      count += n;
+      if (count > capacity)
+      {
+         head = (head + (count - capacity)) % capacity;
+         count = capacity;
+      }
+   }
+
+   //drop the values, that are too old (if "maxAge" is given)
+   void expire()
+   {
+      if (times == nullptr) return;
+      int64_t oldest = now() - maxAge;
+      while ((count > 0) && (times[head] < oldest))
+      {
+         head = (head + 1) % capacity;
+         count--;
+      }
+   }
+
+
+protected:
+   void lockEmission()
+   {
+      emission.lock();
+   }
+
+   void unlockEmission()
+   {
+      emission.unlock();
+   }
+
+   //the latest stored value (there must be one)
+   V const & newest() const
+   {
+      return values[(head + count - 1) % capacity];
+   }
+
+   //pass the stored values after "replayed" to the new subscriber (as one batch - no matter, what the subscriber has
+   //requested). they are copied, so the lock isn't held while passing them
+   bool replay(Observer<V,E> * observer, uint64_t & replayed)
+   {
+      expire();
+      size_t n = ((sequence - replayed) < count) ? (size_t)(sequence - replayed) : count;
+      replayed = sequence;
+      if (n == 0) return false;
+      V * copy = new V[n];
+      size_t first = (head + count - n) % capacity; //the oldest one to pass
+      for (size_t i = 0; i < n; i++) copy[i] = values[(first + i) % capacity];
+      emission.unlock();
+      observer->nextBatch(copy, n);
+      delete[] copy;
+      emission.lock();
+      return true;
+   }
+
+
+public:
+   explicit ReplaySubject(size_t capacity, std::chrono::nanoseconds maxAge = std::chrono::nanoseconds(0))
+   {
+      this->values = (capacity > 0) ? new V[capacity] : nullptr;
+      this->times = ((capacity > 0) && (maxAge.count() > 0)) ? new int64_t[capacity] : nullptr;
+      this->capacity = capacity;
+      this->head = 0;
+      this->count = 0;
+      this->maxAge = maxAge.count();
+      this->sequence = 0;
+   }
+
+   ~ReplaySubject()
+   {
+      delete[] values;
+      delete[] times;
+   }
+
+   //store the value and pass it on to all subscribers
+   void next(V const & value)
+   {
+      std::unique_lock<std::mutex> lock(emission);
+      store(&value, 1);
+      uint64_t first = sequence;
+      lock.unlock();
+      this->deliver(&value, 1, first);
+   }
+
+   void nextBatch(V const * batch, size_t n)
+   {
+      std::unique_lock<std::mutex> lock(emission);
+      store(batch, n);
+      uint64_t first = sequence - n + 1;
+      lock.unlock();
+      this->deliver(batch, n, first);
+   }
+};
+
+
+
+//a subject, that keeps its latest value (starting with an initial one) and passes it to each new subscriber
+template <typename V, typename E>
+class BehaviorSubject : public ReplaySubject<V,E>
+{
+public:
+   explicit BehaviorSubject(V const & initial) : ReplaySubject<V,E>(1)
+   {
+      ReplaySubject<V,E>::next(initial); //nobody has subscribed yet. so it just gets stored
+   }
+
+   //the latest value
+   V value()
+   {
+      this->lockEmission();
+      V latest = this->newest();
+      this->unlockEmission();
+      return latest;
+   }
+};
+
+#endif
@@ -0,0 +1,875 @@
+//-----------------------------------------------------------------------------
+/*!
+   \file
+   \brief Time: a scheduler built on a hierarchical timing wheel and the time-based operators interval, timer,
+          delay and timeout.
+
+   The TimeScheduler interface runs a task (see Timer) at a given time. The WheelScheduler implements it by a
+   thread of its own, that sleeps until the next timer is due:
+
+      WheelScheduler scheduler; //(resolution: 1 ms)
+      interval<int, char const *>(scheduler, std::chrono::milliseconds(100))->subscribe(observer); //0, 1, 2, ...
+
+      TimeoutObserver<int, char const *> timeout(scheduler, std::chrono::seconds(30), "Timeout!");
+      requests->map(timeout)->subscribe(observer); //error, if there is no value for 30 s
+
+   The timers are kept in a hierarchical timing wheel: 11 levels of 64 slots, each slot a (doubly linked) list of
+   timers. Level 0 holds the timers due within the next 64 ticks (one slot per tick), level 1 those due within the next
+   64 * 64 ticks (one slot per 64 ticks) and so on. So "schedule" and "cancel" are O(1) - no matter how many timers
+   there are - and don't allocate (the timers are intrusive). When the time reaches the slot of a higher level, its
+   timers are moved down to the lower levels ("cascading"). Empty slots are skipped by means of a bitmap per level:
+   the scheduler thread wakes up only, when there is something to do - and then handles all ticks, that have passed,
+   at once.
+
+   The operators are built, so they scale to many (hundreds of thousands) subscriptions:
+   - "interval" and "timer" are observables, that emit a counter by the scheduler's thread (one timer each).
+   - DelayObserver (to be used with "map") passes the values on after a delay. The values are queued with their due
+     time - so there is only one timer, for the first one.
+   - TimeoutObserver (to be used with "map") signals an error, if there is no value for a while. A value doesn't
+     touch the scheduler: it just notes the time. When the timer expires, it is re-armed from that time (if there
+     was a value in the meantime).
+   None of them is demand-aware: time doesn't wait for the observer (use the BackpressureObserver, if necessary).
+
+   For tests, the VirtualTimeScheduler replaces the WheelScheduler: its time stands still, until it is advanced
+   ("advanceBy", "advanceTo"). Then it runs the timers, that get due, in the order of their due time - on the calling
+   thread and without sleeping. So hours of stream time pass in milliseconds, and the result is always the same:
+
+      VirtualTimeScheduler scheduler;
+      interval<int, char const *>(scheduler, std::chrono::hours(1))->subscribe(observer);
+      scheduler.advanceBy(std::chrono::hours(24)); //observer gets 0 .. 23
+*/
+//-----------------------------------------------------------------------------
+#ifndef TIMEWHEEL_H
+#define TIMEWHEEL_H
+
+/* -- Includes ------------------------------------------------------------ */
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <mutex>
+#include <new>
+#include <thread>
+#include "arena.h"
+#include "observable.h"
+
+
+/* -- Types --------------------------------------------------------------- */
+
+//a task, that is run at a given time (see TimeScheduler). it is intrusive: the scheduler keeps the timer itself,
+//so a timer must stay alive as long as it is pending (cancel it before destroying it)
+class Timer
+{
+public:
+   Task task;
+
+   Timer()
+   {
+      this->task.run = nullptr;
+      this->task.context = nullptr;
+      this->prev = nullptr;
+      this->next = nullptr;
+      this->due = 0;
+      this->level = 0;
+      this->slot = 0;
+      this->state = IDLE;
+   }
+
+   explicit Timer(Task task) : Timer()
+   {
+      this->task = task;
+   }
+
+private:
+   friend class TimingWheel;
+
+   enum State : uint8_t { IDLE, PENDING, EXPIRED };
+
+   Timer * prev;
+   Timer * next;
+   uint64_t due; //tick
+   uint8_t level; //(where it is kept, while pending)
+   uint8_t slot;
+   uint8_t state;
+
+   //a timer is linked into a list: it can't be copied
+   Timer(Timer const &);
+   Timer & operator=(Timer const &);
+};
+
+
+
+//hierarchical timing wheel. it is passive: it doesn't know about (real) time, its time is "advanced" in ticks.
+//the timers, that have expired, are collected - to be popped and run by the caller. (not thread safe)
+class TimingWheel
+{
+public:
+   static const uint64_t NONE = UINT64_MAX; //(see nextTick)
+
+   explicit TimingWheel(uint64_t tick = 0)
+   {
+      memset(slots, 0, sizeof(slots));
+      memset(occupied, 0, sizeof(occupied));
+      this->expired.head = nullptr;
+      this->expired.tail = nullptr;
+      this->current = tick;
+      this->count = 0;
+   }
+
+   //the current tick
+   uint64_t now() const
+   {
+      return current;
+   }
+
+   //number of timers, that are pending or expired (but not popped yet)
+   size_t size() const
+   {
+      return count;
+   }
+
+   //(re)schedule the timer to expire at the given tick. a tick, that has passed already, expires on the next "advance"
+   void schedule(Timer * timer, uint64_t due)
+   {
+      if (timer->state != Timer::IDLE) remove(timer);
+      timer->due = due;
+      insert(timer);
+      count++;
+   }
+
+   //returns true, if the timer was pending or expired (but not popped yet)
+   bool cancel(Timer * timer)
+   {
+      if (timer->state == Timer::IDLE) return false;
+      remove(timer);
+      return true;
+   }
+
+   //the earliest tick, at which "advance" has something to do: a timer expires or has to be moved to a lower level.
+   //NONE, if there are no pending timers
+   uint64_t nextTick() const
+   {
+      uint64_t next = NONE;
+      for (unsigned level = 0; level < LEVELS; level++)
+      {
+         uint64_t bits = occupied[level];
+         if (bits == 0) continue;
+         unsigned shift = level * BITS;
+         unsigned slot = (unsigned)(current >> shift) & MASK;
+         //the slots of level 0 are the current tick and the following ones of its block. on the higher levels,
+         //the current slot has been moved down already - so only the following slots are left
+         if (level == 0) bits &= ~(uint64_t)0 << slot;
+         else bits = (slot < MASK) ? (bits & (~(uint64_t)0 << (slot + 1))) : 0;
+         if (bits == 0) continue;
+         uint64_t tick = (uint64_t)__builtin_ctzll(bits) << shift;
+         if ((shift + BITS) < 64) tick |= (current >> (shift + BITS)) << (shift + BITS);
+         if (tick < next) next = tick;
+      }
+      return next;
+   }
+
+   //advance the time to the given tick. the timers, that expire (up to that tick), are collected (see popExpired).
+   //only the ticks, at which there is something to do, are visited - the others are skipped
+   void advance(uint64_t tick)
+   {
+      for (;;)
+      {
+         uint64_t next = nextTick();
+         if ((next > tick) || (next == NONE)) break;
+         current = next;
+         //move the timers of the slots, that start now, down (from the top level, as they may get into the next lower one)
+         for (unsigned level = LEVELS - 1; level > 0; level--)
+         {
+            unsigned shift = level * BITS;
+            if ((current & (((uint64_t)1 << shift) - 1)) != 0) continue; //(not at the start of a slot of this level)
+            unsigned slot = (unsigned)(current >> shift) & MASK;
+            if ((occupied[level] & ((uint64_t)1 << slot)) == 0) continue;
+            Timer * timer = slots[level][slot].head;
+            slots[level][slot].head = nullptr;
+            slots[level][slot].tail = nullptr;
+            occupied[level] &= ~((uint64_t)1 << slot);
+            while (timer != nullptr)
+            {
+               Timer * following = timer->next;
+               insert(timer);
+               timer = following;
+            }
+         }
+         //the timers of the current tick have expired
+         unsigned slot = (unsigned)current & MASK;
+         if ((occupied[0] & ((uint64_t)1 << slot)) != 0)
+         {
+            List & list = slots[0][slot];
+            for (Timer * timer = list.head; timer != nullptr; timer = timer->next) timer->state = Timer::EXPIRED;
+            if (expired.tail != nullptr) expired.tail->next = list.head;
+            else expired.head = list.head;
+            list.head->prev = expired.tail;
+            expired.tail = list.tail;
+            list.head = nullptr;
+            list.tail = nullptr;
+            occupied[0] &= ~((uint64_t)1 << slot);
+         }
+      }
+      if (tick > current) current = tick;
+   }
+
+   //the next expired timer (in the order of expiry) - or nullptr
+   Timer * popExpired()
+   {
+      Timer * timer = expired.head;
+      if (timer != nullptr) remove(timer);
+      return timer;
+   }
+
+private:
+   static const unsigned BITS = 6;
+   static const unsigned SLOTS = 1 << BITS;
+   static const unsigned MASK = SLOTS - 1;
+   static const unsigned LEVELS = (64 + BITS - 1) / BITS; //(enough for all 64 bits of a tick)
+
+   struct List
+   {
+      Timer * head;
+      Timer * tail;
+   };
+
+   List slots[LEVELS][SLOTS];
+   uint64_t occupied[LEVELS]; //bitmap of the slots, that aren't empty
+   List expired;
+   uint64_t current;
+   size_t count;
+
+   //the level is the highest group of bits, in which "due" differs from the current tick. (so the timers on level 0
+   //are in the current block of 64 ticks, those on level 1 in the current block of 64 * 64 ticks, ...)
+   void insert(Timer * timer)
+   {
+      uint64_t due = (timer->due > current) ? timer->due : current;
+      uint64_t diff = due ^ current;
+      unsigned level = (diff == 0) ? 0 : (unsigned)(63 - __builtin_clzll(diff)) / BITS;
+      unsigned slot = (unsigned)(due >> (level * BITS)) & MASK;
+      append(slots[level][slot], timer);
+      occupied[level] |= (uint64_t)1 << slot;
+      timer->level = (uint8_t)level;
+      timer->slot = (uint8_t)slot;
+      timer->state = Timer::PENDING;
+   }
+
+   void remove(Timer * timer)
+   {
+      bool pending = (timer->state == Timer::PENDING);
+      List & list = pending ? slots[timer->level][timer->slot] : expired;
+      if (timer->prev != nullptr) timer->prev->next = timer->next;
+      else list.head = timer->next;
+      if (timer->next != nullptr) timer->next->prev = timer->prev;
+      else list.tail = timer->prev;
+      if (pending && (list.head == nullptr)) occupied[timer->level] &= ~((uint64_t)1 << timer->slot);
+      timer->prev = nullptr;
+      timer->next = nullptr;
+      timer->state = Timer::IDLE;
+      count--;
+   }
+
+   static void append(List & list, Timer * timer)
+   {
+      timer->prev = list.tail;
+      timer->next = nullptr;
+      if (list.tail != nullptr) list.tail->next = timer;
+      else list.head = timer;
+      list.tail = timer;
+   }
+
+   TimingWheel(TimingWheel const &);
+   TimingWheel & operator=(TimingWheel const &);
+};
+
+
+
+//runs timers at a given time. the time is in ns - of the scheduler's own clock (see "now")
+class TimeScheduler
+{
+public:
+   virtual ~TimeScheduler() { }
+
+   virtual int64_t now() = 0;
+
+   //(re)schedule the timer: its task is run at (or soon after) "due". may be called from within a task
+   virtual void schedule(Timer & timer, int64_t due) = 0;
+
+   //returns true, if the timer was pending. afterwards the timer's task doesn't run (any more) - if it is running
+   //right now (by another thread), "cancel" waits until it has finished
+   virtual bool cancel(Timer & timer) = 0;
+};
+
+
+
+//scheduler, that runs the timers by a thread of its own. the time is rounded up to ticks of the given resolution.
+//a mutex guards the wheel - but it isn't held while a timer's task runs
+class WheelScheduler : public TimeScheduler
+{
+public:
+   explicit WheelScheduler(std::chrono::nanoseconds resolution = std::chrono::milliseconds(1))
+   {
+      this->resolution = (resolution.count() > 0) ? (int64_t)resolution.count() : 1;
+      this->origin = now();
+      this->running = nullptr;
+      this->waiting = 0;
+      this->wakeTick = TimingWheel::NONE;
+      this->stopping = false;
+      this->thread = std::thread(&WheelScheduler::run, this);
+   }
+
+   //stops the thread. the timers, that are still pending, don't run
+   ~WheelScheduler()
+   {
+      {
+         std::lock_guard<std::mutex> lock(mutex);
+         stopping = true;
+      }
+      wakeup.notify_one();
+      thread.join();
+   }
+
+   int64_t now()
+   {
+      return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+   }
+
+   void schedule(Timer & timer, int64_t due)
+   {
+      uint64_t tick = (due > origin) ? (uint64_t)((due - origin + resolution - 1) / resolution) : 0;
+      std::lock_guard<std::mutex> lock(mutex);
+      wheel.schedule(&timer, tick);
+      if (tick < wakeTick) //earlier than the thread is going to wake up
+      {
+         wakeTick = tick;
+         wakeup.notify_one();
+      }
+   }
+
+   bool cancel(Timer & timer)
+   {
+      std::unique_lock<std::mutex> lock(mutex);
+      bool cancelled = false;
+      for (;;)
+      {
+         if (wheel.cancel(&timer)) cancelled = true;
+         if ((running != &timer) || (std::this_thread::get_id() == thread.get_id())) break;
+         //its task is running. (it may reschedule the timer - so check again, when it has finished)
+         waiting++;
+         finished.wait(lock);
+         waiting--;
+      }
+      return cancelled;
+   }
+
+   //number of timers, that are pending
+   size_t pending()
+   {
+      std::lock_guard<std::mutex> lock(mutex);
+      return wheel.size();
+   }
+
+private:
+   TimingWheel wheel;
+   int64_t resolution; //ns per tick
+   int64_t origin; //time of tick 0
+   Timer * running; //the timer, whose task is running
+   size_t waiting; //number of threads, that wait (in "cancel") for it to finish
+   uint64_t wakeTick; //the tick, at which the thread is going to wake up (0: it is awake)
+   bool stopping;
+   std::mutex mutex;
+   std::condition_variable wakeup;
+   std::condition_variable finished;
+   std::thread thread;
+
+   WheelScheduler(WheelScheduler const &);
+   WheelScheduler & operator=(WheelScheduler const &);
+
+
+   void run()
+   {
+      std::unique_lock<std::mutex> lock(mutex);
+      while (!stopping)
+      {
+         wakeTick = 0;
+         //all ticks, that have passed since the last run, at once
+         int64_t elapsed = now() - origin;
+         wheel.advance((elapsed > 0) ? (uint64_t)(elapsed / resolution) : 0);
+         while (Timer * timer = wheel.popExpired())
+         {
+            running = timer;
+            lock.unlock();
+            timer->task.run(timer->task.context);
+            lock.lock();
+            running = nullptr;
+            if (waiting > 0) finished.notify_all();
+            if (stopping) return;
+         }
+         //sleep until the next tick, at which there is something to do
+         uint64_t next = wheel.nextTick();
+         wakeTick = next;
+         if ((next == TimingWheel::NONE) || (next > (uint64_t)((INT64_MAX - origin) / resolution))) wakeup.wait(lock);
+         else wakeup.wait_until(lock, std::chrono::steady_clock::time_point(std::chrono::nanoseconds(origin + (int64_t)next * resolution)));
+      }
+   }
+};
+
+
+
+//scheduler with a virtual time (ns, starting at 0), for tests. the time only moves by "advanceBy" / "advanceTo" - which run
+//the timers on the calling thread. (not thread safe: to be used by one thread)
+class VirtualTimeScheduler : public TimeScheduler
+{
+public:
+   VirtualTimeScheduler()
+   {
+      this->running = false;
+   }
+
+   int64_t now()
+   {
+      return (int64_t)wheel.now();
+   }
+
+   void schedule(Timer & timer, int64_t due)
+   {
+      wheel.schedule(&timer, (due > 0) ? (uint64_t)due : 0);
+   }
+
+   bool cancel(Timer & timer)
+   {
+      return wheel.cancel(&timer);
+   }
+
+   //number of timers, that are pending
+   size_t pending() const
+   {
+      return wheel.size();
+   }
+
+   //advance the time to "time" (ns). each timer runs at its due time (that's what "now" returns meanwhile) - the timers
+   //scheduled by them included, if they get due until "time". a time in the past is ignored
+   void advanceTo(int64_t time)
+   {
+      if (running) return; //(called by a timer's task)
+      running = true;
+      uint64_t tick = (time > 0) ? (uint64_t)time : 0;
+      for (;;)
+      {
+         uint64_t next = wheel.nextTick();
+         if ((next == TimingWheel::NONE) || (next > tick)) break;
+         wheel.advance(next);
+         while (Timer * timer = wheel.popExpired()) timer->task.run(timer->task.context);
+      }
+      wheel.advance(tick);
+      running = false;
+   }
+
+   void advanceBy(std::chrono::nanoseconds duration)
+   {
+      if (duration.count() > 0) advanceTo(now() + (int64_t)duration.count());
+   }
+
+private:
+   TimingWheel wheel; //(1 tick = 1 ns)
+   bool running; //"advanceTo" is running
+
+   VirtualTimeScheduler(VirtualTimeScheduler const &);
+   VirtualTimeScheduler & operator=(VirtualTimeScheduler const &);
+};
+
+
+
+//observable constructed using "timer" or "interval"
+template <typename V, typename E>
+class ObservableTimer : public Observable<V,E>
+{
+public:
+   //create the observable - either on the heap or (if given) in the arena
+   static ObservableTimer * construct(TimeScheduler & scheduler, int64_t delay, int64_t period, ObservableArena * arena)
+   {
+      ObservableTimer * thiz = (arena == nullptr) ? new ObservableTimer() : arena->make<ObservableTimer>();
+      thiz->scheduler = &scheduler;
+      thiz->delay = (delay > 0) ? delay : 0;
+      thiz->period = (period > 0) ? period : 0;
+      return thiz;
+   }
+
+   ~ObservableTimer()
+   {
+      if (scheduler != nullptr) scheduler->cancel(timer);
+   }
+
+private:
+   TimeScheduler * scheduler;
+   Observer<V,E> * observer;
+   Timer timer;
+   int64_t delay; //ns until the first value
+   int64_t period; //ns between the values (0: there is just one value)
+   int64_t first; //time of the first value
+   uint64_t count; //number of values emitted
+
+   friend class ObservableArena;
+
+   ObservableTimer()
+   {
+      this->subscribeHandler = static_cast<typename Observable<V,E>::SubscribeHandler>(&ObservableTimer::subscribeHandler_timer);
+      this->scheduler = nullptr;
+      this->observer = nullptr;
+      this->timer.task.run = &ObservableTimer::expire;
+      this->timer.task.context = this;
+      this->delay = 0;
+      this->period = 0;
+      this->first = 0;
+      this->count = 0;
+   }
+
+   //this is the method that is called when someone subscribes to the observable that was constructed using "timer"
+   Subscription * subscribeHandler_timer(Observer<V,E> * observer)
+   {
+      //prevent further invocation (there is only room for one observer)
+      this->subscribeHandler = nullptr;
+      this->observer = observer;
+      observer->start(this);
+      if (this->isClosed()) return this;
+      first = scheduler->now() + delay;
+      scheduler->schedule(timer, first);
+      return this;
+   }
+
+   //(run by the scheduler)
+   static void expire(void * context)
+   {
+      ObservableTimer * thiz = (ObservableTimer *)context;
+      if (thiz->isClosed()) return;
+      thiz->observer->next(V(thiz->count));
+      thiz->count++;
+      if (thiz->isClosed()) return;
+      //the values follow the period from the first one: a late value doesn't delay the next one
+      if (thiz->period > 0) thiz->scheduler->schedule(thiz->timer, thiz->first + (int64_t)thiz->count * thiz->period);
+      else thiz->observer->complete();
+   }
+
+   void unsubscribe()
+   {
+      Observable<V,E>::unsubscribe();
+      scheduler->cancel(timer);
+   }
+};
+
+
+
+//mapping observer, that passes the values on after a delay (by the scheduler's thread). complete is delayed as well
+//(it follows the last value). an error is passed on right away - the values, that haven't been passed on yet, are dropped
+template <typename V, typename E>
+class DelayObserver : public MappingObserver<V,E>
+{
+public:
+   DelayObserver(TimeScheduler & scheduler, std::chrono::nanoseconds delay)
+   {
+      this->scheduler = &scheduler;
+      this->delay = (delay.count() > 0) ? (int64_t)delay.count() : 0;
+      init();
+   }
+
+   //(copies the configuration only - e.g. for a cold observable)
+   DelayObserver(DelayObserver const & other) : MappingObserver<V,E>(other)
+   {
+      this->scheduler = other.scheduler;
+      this->delay = other.delay;
+      init();
+   }
+
+   ~DelayObserver()
+   {
+      scheduler->cancel(timer);
+      delete[] values;
+      delete[] dues;
+   }
+
+   void next(V const & value)
+   {
+      nextBatch(&value, 1);
+   }
+
+   void nextBatch(V const * values, size_t count)
+   {
+      int64_t due = scheduler->now() + delay;
+      std::lock_guard<std::mutex> lock(mutex);
+      if (failed) return;
+      bool first = (queued == 0);
+      for (size_t i = 0; i < count; i++) push(values[i], due);
+      if (first) scheduler->schedule(timer, due);
+   }
+
+   void error(E const & err)
+   {
+      std::lock_guard<std::mutex> lock(mutex);
+      failed = true;
+      this->err = err;
+      queued = 0;
+      head = 0;
+      scheduler->schedule(timer, scheduler->now());
+   }
+
+   void complete()
+   {
+      std::unique_lock<std::mutex> lock(mutex);
+      completed = true;
+      if (errorPassed) //the error has been passed on already (without delay) - so is complete
+      {
+         lock.unlock();
+         this->observer->complete();
+         return;
+      }
+      if (failed) return; //passed on by "expire", after the error
+      if (queued == 0) scheduler->schedule(timer, scheduler->now());
+   }
+
+private:
+   static const size_t CHUNK = 64; //max. number of values passed at once to "nextBatch"
+
+   TimeScheduler * scheduler;
+   int64_t delay; //ns
+   Timer timer; //(due, when the first queued value is due)
+   std::mutex mutex; //guards the queue and the flags (the values arrive by another thread, than they leave)
+   V * values; //queue (ring buffer, grows as needed)
+   int64_t * dues; //due time of each value
+   size_t capacity;
+   size_t head;
+   size_t queued;
+   bool completed;
+   bool failed;
+   bool terminated; //error/complete have been passed on (or are being passed on right now)
+   bool errorPassed; //"expire" has returned from passing on the error
+   E err;
+
+   void init()
+   {
+      this->timer.task.run = &DelayObserver::expire;
+      this->timer.task.context = this;
+      this->values = nullptr;
+      this->dues = nullptr;
+      this->capacity = 0;
+      this->head = 0;
+      this->queued = 0;
+      this->completed = false;
+      this->failed = false;
+      this->terminated = false;
+      this->errorPassed = false;
+   }
+
+   void push(V const & value, int64_t due)
+   {
+      if (queued == capacity) //grow (and unwrap)
+      {
+         size_t size = (capacity > 0) ? (2 * capacity) : 16;
+         V * grownValues = new V[size];
+         int64_t * grownDues = new int64_t[size];
+         for (size_t i = 0; i < queued; i++)
+         {
+            grownValues[i] = values[(head + i) % capacity];
+            grownDues[i] = dues[(head + i) % capacity];
+         }
+         delete[] values;
+         delete[] dues;
+         values = grownValues;
+         dues = grownDues;
+         capacity = size;
+         head = 0;
+      }
+      size_t tail = (head + queued) % capacity;
+      values[tail] = value;
+      dues[tail] = due;
+      queued++;
+   }
+
+   //(run by the scheduler) pass the values on, that are due - chunk-wise, the mutex isn't held while doing so
+   static void expire(void * context)
+   {
+      DelayObserver * thiz = (DelayObserver *)context;
+      V chunk[CHUNK];
+      int64_t now = thiz->scheduler->now();
+      std::unique_lock<std::mutex> lock(thiz->mutex);
+      while (!thiz->terminated)
+      {
+         if (thiz->isUnsubscribed()) //(by the downstream observer)
+         {
+            thiz->queued = 0;
+            return;
+         }
+         size_t n = 0;
+         while ((n < CHUNK) && (thiz->queued > 0) && (thiz->dues[thiz->head] <= now))
+         {
+            chunk[n++] = thiz->values[thiz->head];
+            thiz->head = (thiz->head + 1) % thiz->capacity;
+            thiz->queued--;
+         }
+         if (n > 0)
+         {
+            lock.unlock();
+            thiz->observer->nextBatch(chunk, n);
+            lock.lock();
+            continue;
+         }
+         if (thiz->failed)
+         {
+            thiz->terminated = true;
+            E err = thiz->err;
+            lock.unlock();
+            thiz->observer->error(err);
+            lock.lock();
+            thiz->errorPassed = true; //a complete, that arrives from now on, is passed on by "complete"
+            bool completed = thiz->completed;
+            lock.unlock();
+            if (completed) thiz->observer->complete();
+            return;
+         }
+         if (thiz->queued > 0) thiz->scheduler->schedule(thiz->timer, thiz->dues[thiz->head]);
+         else if (thiz->completed)
+         {
+            thiz->terminated = true;
+            lock.unlock();
+            thiz->observer->complete();
+         }
+         return;
+      }
+   }
+};
+
+
+
+//mapping observer, that signals an error (and unsubscribes from the upstream), if there is no value within "timeout"
+//after the start or after the previous value. the values are passed on unchanged
+template <typename V, typename E>
+class TimeoutObserver : public MappingObserver<V,E>
+{
+public:
+   TimeoutObserver(TimeScheduler & scheduler, std::chrono::nanoseconds timeout, E const & timeoutError) : timeoutError(timeoutError)
+   {
+      this->scheduler = &scheduler;
+      this->timeout = (int64_t)timeout.count();
+      init();
+   }
+
+   //(copies the configuration only - e.g. for a cold observable)
+   TimeoutObserver(TimeoutObserver const & other) : MappingObserver<V,E>(other), timeoutError(other.timeoutError)
+   {
+      this->scheduler = other.scheduler;
+      this->timeout = other.timeout;
+      init();
+   }
+
+   ~TimeoutObserver()
+   {
+      scheduler->cancel(timer);
+   }
+
+   void start(Subscription * subscription)
+   {
+      MappingObserver<V,E>::start(subscription);
+      int64_t now = scheduler->now();
+      lastValue.store(now, std::memory_order_relaxed);
+      scheduler->schedule(timer, now + timeout);
+   }
+
+   void next(V const & value)
+   {
+      std::lock_guard<std::mutex> lock(mutex);
+      if (terminated.load(std::memory_order_relaxed)) return;
+      lastValue.store(scheduler->now(), std::memory_order_relaxed);
+      this->observer->next(value);
+   }
+
+   void nextBatch(V const * values, size_t count)
+   {
+      std::lock_guard<std::mutex> lock(mutex);
+      if (terminated.load(std::memory_order_relaxed)) return;
+      lastValue.store(scheduler->now(), std::memory_order_relaxed);
+      this->observer->nextBatch(values, count);
+   }
+
+   void error(E const & err)
+   {
+      {
+         std::lock_guard<std::mutex> lock(mutex);
+         if (terminated.load(std::memory_order_relaxed)) return;
+         terminated.store(true, std::memory_order_relaxed);
+         this->observer->error(err);
+      }
+      scheduler->cancel(timer); //(not while holding the mutex: the timer's task may be waiting for it)
+   }
+
+   void complete()
+   {
+      {
+         std::lock_guard<std::mutex> lock(mutex);
+         if (terminated.load(std::memory_order_relaxed)) return;
+         terminated.store(true, std::memory_order_relaxed);
+         this->observer->complete();
+      }
+      scheduler->cancel(timer);
+   }
+
+private:
+   TimeScheduler * scheduler;
+   int64_t timeout; //ns
+   E timeoutError;
+   Timer timer;
+   std::atomic<int64_t> lastValue; //time of the last value (or of the start)
+   std::atomic<bool> terminated; //error/complete have been passed on
+   std::mutex mutex; //the notifications of the upstream and the timeout are passed on one at a time
+
+   void init()
+   {
+      this->timer.task.run = &TimeoutObserver::expire;
+      this->timer.task.context = this;
+      this->lastValue.store(0, std::memory_order_relaxed);
+      this->terminated.store(false, std::memory_order_relaxed);
+   }
+
+   //(run by the scheduler)
+   static void expire(void * context)
+   {
+      TimeoutObserver * thiz = (TimeoutObserver *)context;
+      if (thiz->terminated.load(std::memory_order_relaxed) || thiz->isUnsubscribed()) return;
+      //the timer isn't moved by each value. so there may have been values since it was scheduled: re-arm it from the last one
+      int64_t due = thiz->lastValue.load(std::memory_order_relaxed) + thiz->timeout;
+      if (thiz->scheduler->now() < due)
+      {
+         thiz->scheduler->schedule(thiz->timer, due);
+         return;
+      }
+      {
+         std::lock_guard<std::mutex> lock(thiz->mutex);
+         if (thiz->terminated.load(std::memory_order_relaxed)) return;
+         thiz->terminated.store(true, std::memory_order_relaxed);
+         thiz->observer->error(thiz->timeoutError);
+         thiz->observer->complete();
+      }
+      if (thiz->subscription != nullptr) thiz->subscription->unsubscribe();
+   }
+};
+
+
+
+/* -- Factory functions --------------------------------------------------- */
+
+//construct an observable, that emits 0 after "delay" - and then 1, 2, 3, ... each "period" (0: complete after the 0)
+template <typename V, typename E>
+Observable<V,E> * timer(TimeScheduler & scheduler, std::chrono::nanoseconds delay,
+                        std::chrono::nanoseconds period = std::chrono::nanoseconds(0), ObservableArena * arena = nullptr)
+{
+   return ObservableTimer<V,E>::construct(scheduler, (int64_t)delay.count(), (int64_t)period.count(), arena);
+}
+
+//construct an observable, that emits 0, 1, 2, ... each "period" (the first one after "period")
+template <typename V, typename E>
+Observable<V,E> * interval(TimeScheduler & scheduler, std::chrono::nanoseconds period, ObservableArena * arena = nullptr)
+{
+   return ObservableTimer<V,E>::construct(scheduler, (int64_t)period.count(), (int64_t)period.count(), arena);
+}
+
+#endif
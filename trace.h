@@ -0,0 +1,338 @@
+//-----------------------------------------------------------------------------
+/*!
+   \file
+   \brief Tracing of the lifecycle of subscriptions, written as Chrome trace (trace event JSON).
+
+   When does "subscribe" happen, when "complete" and "unsubscribe" - and on which thread? How long does each batch
+   take in each stage? Compiled with OBSERVABLE_TRACING set to 1, the observables record:
+
+   - "subscribe": a span for each call of "subscribe" (which runs the subscribe handler of the observable)
+   - "unsubscribe": an instant event, when an observable gets unsubscribed
+   - "next" / "nextBatch": a span for each call of a "map" stage (with the number of values)
+   - "error" / "complete": an instant event, when a "map" stage gets them
+
+   Each event carries the type of the observable or stage ("operator") and its address ("id").
+
+      g++ -DOBSERVABLE_TRACING=1 main.cpp
+
+      ...
+      tracing::writeJson("trace.json"); //open it in chrome://tracing or https://ui.perfetto.dev
+
+   Recording is cheap: each thread appends to a buffer of its own (no lock, no atomic read-modify-write). The buffers
+   are chains of fixed-size chunks; a new chunk is taken when the current one is full. "writeJson" may be called
+   at any time (while other threads record) - it writes the events recorded since its last call and hands the chunks,
+   that it has written completely, back to their threads to be reused. So calling it periodically (each file holds
+   the events of one period) keeps the memory bounded. The type names are demangled then, not while recording. Without OBSERVABLE_TRACING (the default), nothing is recorded - and there is no cost.
+*/
+//-----------------------------------------------------------------------------
+#ifndef TRACE_H
+#define TRACE_H
+
+/* -- Includes ------------------------------------------------------------ */
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <atomic>
+#include <chrono>
+#include <mutex>
+#include <new>
+#include <typeinfo>
+#if defined(__GNUC__)
+#include <cxxabi.h>
+#endif
+
+
+/* -- Defines ------------------------------------------------------------- */
+#ifndef OBSERVABLE_TRACING
+#define OBSERVABLE_TRACING 0
+#endif
+
+
+/* -- Types --------------------------------------------------------------- */
+
+struct TraceEvent
+{
+   char const * name; //(a string literal)
+   std::type_info const * type; //type of the observable / stage
+   void const * id;
+   uint64_t start; //ns
+   uint64_t duration; //ns (spans only)
+   uint64_t count; //number of values (batches only)
+   char phase; //'X': span, 'i': instant event
+};
+
+
+//the events of one thread: written by that thread only, read (and drained) by "writeJson"
+class TraceBuffer
+{
+public:
+   static const size_t CHUNK_EVENTS = 4096;
+
+   struct Chunk
+   {
+      TraceEvent events[CHUNK_EVENTS];
+      std::atomic<size_t> count; //events written (published)
+      std::atomic<Chunk *> next;
+   };
+
+   Chunk * first; //the oldest chunk, that hasn't been written completely (used by "writeJson" only)
+   size_t written; //number of events of "first", that have been written
+   Chunk * current; //the chunk, the thread appends to (used by the thread only)
+   Chunk * spares; //chunks to be reused (used by the thread only)
+   std::atomic<Chunk *> recycled; //chunks handed back by "writeJson" (linked by "next")
+   unsigned thread; //(a small number instead of the system's thread id)
+   TraceBuffer * nextBuffer; //list of all buffers (see TraceRecorder)
+
+   explicit TraceBuffer(unsigned thread) : recycled(nullptr)
+   {
+      this->spares = nullptr;
+      this->first = newChunk();
+      this->written = 0;
+      this->current = this->first;
+      this->thread = thread;
+      this->nextBuffer = nullptr;
+   }
+
+   void append(TraceEvent const & event)
+   {
+      size_t n = current->count.load(std::memory_order_relaxed);
+      if (n == CHUNK_EVENTS)
+      {
+         Chunk * chunk = newChunk();
+         current->next.store(chunk, std::memory_order_release); //from now on, the thread doesn't touch "current" any more
+         current = chunk;
+         n = 0;
+      }
+      current->events[n] = event;
+      current->count.store(n + 1, std::memory_order_release);
+   }
+
+   //pass the events, that haven't been written yet, to "write" and recycle the chunks, that are done
+   template <typename F>
+   void drain(F write)
+   {
+      for (;;)
+      {
+         size_t count = first->count.load(std::memory_order_acquire);
+         for (; written < count; written++) write(first->events[written]);
+         if (count < CHUNK_EVENTS) return;
+         Chunk * next = first->next.load(std::memory_order_acquire);
+         if (next == nullptr) return; //the thread hasn't taken the next chunk yet
+         recycle(first);
+         first = next;
+         written = 0;
+      }
+   }
+
+private:
+   //reuse a recycled chunk - or allocate a new one
+   Chunk * newChunk()
+   {
+      if (spares == nullptr) spares = recycled.exchange(nullptr, std::memory_order_acquire);
+      Chunk * chunk = spares;
+      if (chunk != nullptr)
+      {
+         spares = chunk->next.load(std::memory_order_relaxed);
+         chunk->count.store(0, std::memory_order_relaxed);
+         chunk->next.store(nullptr, std::memory_order_relaxed);
+         return chunk;
+      }
+      chunk = (Chunk *)malloc(sizeof(Chunk));
+      if (chunk == nullptr) throw std::bad_alloc();
+      new (&chunk->count) std::atomic<size_t>(0);
+      new (&chunk->next) std::atomic<Chunk *>(nullptr);
+      return chunk;
+   }
+
+   //hand a chunk, that has been written, back to the thread
+   void recycle(Chunk * chunk)
+   {
+      Chunk * head = recycled.load(std::memory_order_relaxed);
+      do chunk->next.store(head, std::memory_order_relaxed);
+      while (!recycled.compare_exchange_weak(head, chunk, std::memory_order_release, std::memory_order_relaxed));
+   }
+};
+
+
+
+//all buffers. (they live as long as the program - a thread, that has ended, may still have events to be written)
+class TraceRecorder
+{
+public:
+   static TraceRecorder & instance()
+   {
+      static TraceRecorder recorder;
+      return recorder;
+   }
+
+   static uint64_t now()
+   {
+      return (uint64_t)std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+   }
+
+   bool isEnabled() const
+   {
+      return enabled.load(std::memory_order_relaxed);
+   }
+
+   void enable(bool on)
+   {
+      enabled.store(on, std::memory_order_relaxed);
+   }
+
+   void record(TraceEvent const & event)
+   {
+      static thread_local TraceBuffer * buffer = nullptr;
+      if (buffer == nullptr) buffer = newBuffer();
+      buffer->append(event);
+   }
+
+   //write the events recorded since the last call. returns false, if the file can't be written
+   bool writeJson(char const * path)
+   {
+      FILE * file = fopen(path, "w");
+      if (file == nullptr) return false;
+      fprintf(file, "{\"displayTimeUnit\":\"ns\",\"traceEvents\":[\n");
+      bool separate = false;
+      std::lock_guard<std::mutex> lock(mutex);
+      for (TraceBuffer * buffer = buffers; buffer != nullptr; buffer = buffer->nextBuffer)
+      {
+         fprintf(file, "%s{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":%u,\"args\":{\"name\":\"thread %u\"}}",
+                 separate ? ",\n" : "", buffer->thread, buffer->thread);
+         separate = true;
+         unsigned thread = buffer->thread;
+         buffer->drain([file, thread](TraceEvent const & event) { writeEvent(file, event, thread); });
+      }
+      fprintf(file, "\n]}\n");
+      return fclose(file) == 0;
+   }
+
+private:
+   std::mutex mutex; //guards the list of buffers (taken once per thread - and by "writeJson")
+   TraceBuffer * buffers;
+   TraceBuffer * lastBuffer;
+   unsigned threads;
+   std::atomic<bool> enabled;
+
+   TraceRecorder() : enabled(true)
+   {
+      this->buffers = nullptr;
+      this->lastBuffer = nullptr;
+      this->threads = 0;
+   }
+
+   TraceBuffer * newBuffer()
+   {
+      std::lock_guard<std::mutex> lock(mutex);
+      TraceBuffer * buffer = new TraceBuffer(++threads);
+      if (lastBuffer != nullptr) lastBuffer->nextBuffer = buffer;
+      else buffers = buffer;
+      lastBuffer = buffer;
+      return buffer;
+   }
+
+   static void writeString(FILE * file, char const * text)
+   {
+      fputc('"', file);
+      for (; *text != '\0'; text++)
+      {
+         if ((*text == '"') || (*text == '\\')) fputc('\\', file);
+         fputc(*text, file);
+      }
+      fputc('"', file);
+   }
+
+   static void writeType(FILE * file, std::type_info const & type)
+   {
+#if defined(__GNUC__)
+      int status = 0;
+      char * demangled = abi::__cxa_demangle(type.name(), nullptr, nullptr, &status);
+      writeString(file, (demangled != nullptr) ? demangled : type.name());
+      free(demangled);
+#else
+      writeString(file, type.name());
+#endif
+   }
+
+   //(the timestamps of the trace event format are in us)
+   static void writeEvent(FILE * file, TraceEvent const & event, unsigned thread)
+   {
+      fprintf(file, ",\n{\"name\":");
+      writeString(file, event.name);
+      fprintf(file, ",\"cat\":\"observable\",\"ph\":\"%c\",\"ts\":%llu.%03u,", event.phase,
+              (unsigned long long)(event.start / 1000), (unsigned)(event.start % 1000));
+      if (event.phase == 'X') fprintf(file, "\"dur\":%llu.%03u,", (unsigned long long)(event.duration / 1000), (unsigned)(event.duration % 1000));
+      else fprintf(file, "\"s\":\"t\",");
+      fprintf(file, "\"pid\":1,\"tid\":%u,\"args\":{\"operator\":", thread);
+      writeType(file, *event.type);
+      fprintf(file, ",\"id\":\"%p\"", event.id);
+      if (event.count > 0) fprintf(file, ",\"values\":%llu", (unsigned long long)event.count);
+      fprintf(file, "}}");
+   }
+};
+
+
+
+//records a span from its construction to its destruction
+class TraceSpan
+{
+public:
+   TraceSpan(char const * name, std::type_info const & type, void const * id, uint64_t count = 0)
+   {
+      recording = TraceRecorder::instance().isEnabled();
+      if (!recording) return;
+      event.name = name;
+      event.type = &type;
+      event.id = id;
+      event.count = count;
+      event.phase = 'X';
+      event.start = TraceRecorder::now();
+   }
+
+   ~TraceSpan()
+   {
+      if (!recording) return;
+      event.duration = TraceRecorder::now() - event.start;
+      TraceRecorder::instance().record(event);
+   }
+
+private:
+   TraceEvent event;
+   bool recording;
+
+   TraceSpan(TraceSpan const &);
+   TraceSpan & operator=(TraceSpan const &);
+};
+
+
+
+/* -- Functions ----------------------------------------------------------- */
+
+namespace tracing
+{
+
+//record an instant event
+inline void instant(char const * name, std::type_info const & type, void const * id)
+{
+   TraceRecorder & recorder = TraceRecorder::instance();
+   if (!recorder.isEnabled()) return;
+   TraceEvent event = { name, &type, id, TraceRecorder::now(), 0, 0, 'i' };
+   recorder.record(event);
+}
+
+//pause (or resume) recording. (it is on from the start)
+inline void enable(bool on)
+{
+   TraceRecorder::instance().enable(on);
+}
+
+//write the events recorded since the last call to the given file (trace event JSON)
+inline bool writeJson(char const * path)
+{
+   return TraceRecorder::instance().writeJson(path);
+}
+
+} //namespace tracing
+
+#endif
@@ -0,0 +1,425 @@
+//-----------------------------------------------------------------------------
+/*!
+   \file
+   \brief A work-stealing executor.
+
+   The ThreadPool in scheduler.h hands out its tasks round robin. That's fine as long as all tasks take about the
+   same time. With many independent subscriptions of different size, some threads run dry while others still
+   have a long queue. And a single queue shared by all threads would become the bottleneck on many cores.
+
+   The WorkStealingExecutor gives each worker thread its own deque (Chase-Lev). A worker pushes and pops the
+   tasks it spawns itself at the bottom of its deque (LIFO, cache friendly). A worker that runs out of work
+   "steals" from the top of a randomly chosen other worker's deque. Tasks submitted from outside (non worker
+   threads) are handed over through a lock-free inbox per worker, from where a worker moves them into its
+   deque (so they can be stolen as well). Any worker drains any inbox (one at a time), so a task doesn't wait
+   for a worker, that is blocked by a long running task. A worker that finds nothing to do at all, parks until
+   it gets woken.
+
+   The statistics (executed tasks, steals, queue depths) show, how well the work is distributed.
+
+      WorkStealingExecutor executor; //one worker per core
+      observable->subscribeOn(executor)->subscribe(observer);
+*/
+//-----------------------------------------------------------------------------
+#ifndef WORKSTEALING_H
+#define WORKSTEALING_H
+
+/* -- Includes ------------------------------------------------------------ */
+#include <stddef.h>
+#include <stdint.h>
+#include <atomic>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+#include <vector>
+#include "observable.h"
+#include "scheduler.h"
+
+
+/* -- Types --------------------------------------------------------------- */
+
+//bounded work-stealing deque of tasks (Chase-Lev, as described by Le, Pop, Cohen and Zappa Nardelli).
+//the owner thread pushes and pops at the bottom, other threads steal from the top.
+class TaskDeque
+{
+public:
+   //capacity is rounded up to a power of two
+   explicit TaskDeque(size_t capacity)
+   {
+      size_t size = 2;
+      while (size < capacity) size *= 2;
+      this->mask = (int64_t)size - 1;
+      this->cells = new Cell[size];
+      this->top = 0;
+      this->bottom = 0;
+   }
+
+   ~TaskDeque()
+   {
+      delete[] cells;
+   }
+
+   //owner only. returns false if the deque is full
+   bool push(Task const & task)
+   {
+      int64_t b = bottom.load(std::memory_order_relaxed);
+      int64_t t = top.load(std::memory_order_acquire);
+      if (b - t > mask) return false;
+      cells[b & mask].run.store(task.run, std::memory_order_relaxed);
+      cells[b & mask].context.store(task.context, std::memory_order_relaxed);
+      std::atomic_thread_fence(std::memory_order_release);
+      bottom.store(b + 1, std::memory_order_relaxed);
+      return true;
+   }
+
+   //owner only. returns false if the deque is empty
+   bool pop(Task & task)
+   {
+      int64_t b = bottom.load(std::memory_order_relaxed) - 1;
+      bottom.store(b, std::memory_order_relaxed);
+      std::atomic_thread_fence(std::memory_order_seq_cst);
+      int64_t t = top.load(std::memory_order_relaxed);
+      if (t > b) //empty
+      {
+         bottom.store(b + 1, std::memory_order_relaxed);
+         return false;
+      }
+      task.run = cells[b & mask].run.load(std::memory_order_relaxed);
+      task.context = cells[b & mask].context.load(std::memory_order_relaxed);
+      if (t == b) //the last one. race against the thieves
+      {
+         bool won = top.compare_exchange_strong(t, t + 1, std::memory_order_seq_cst, std::memory_order_relaxed);
+         bottom.store(b + 1, std::memory_order_relaxed);
+         return won;
+      }
+      return true;
+   }
+
+   //any thread. returns false if the deque is empty (or another thread was faster)
+   bool steal(Task & task)
+   {
+      int64_t t = top.load(std::memory_order_acquire);
+      std::atomic_thread_fence(std::memory_order_seq_cst);
+      int64_t b = bottom.load(std::memory_order_acquire);
+      if (t >= b) return false;
+      //the cell might get overwritten by the owner as soon as "top" has moved on.
+      //but then the CAS fails and the (torn) task isn't used
+      task.run = cells[t & mask].run.load(std::memory_order_relaxed);
+      task.context = cells[t & mask].context.load(std::memory_order_relaxed);
+      return top.compare_exchange_strong(t, t + 1, std::memory_order_seq_cst, std::memory_order_relaxed);
+   }
+
+   //number of queued tasks (just a snapshot, e.g. for statistics)
+   size_t size() const
+   {
+      int64_t b = bottom.load(std::memory_order_relaxed);
+      int64_t t = top.load(std::memory_order_relaxed);
+      return (b > t) ? (size_t)(b - t) : 0;
+   }
+
+private:
+   TaskDeque(TaskDeque const &);
+   TaskDeque & operator=(TaskDeque const &);
+
+   struct Cell
+   {
+      std::atomic<void (*)(void *)> run;
+      std::atomic<void *> context;
+   };
+
+   Cell * cells;
+   int64_t mask;
+   alignas(CACHE_LINE_SIZE) std::atomic<int64_t> top;
+   alignas(CACHE_LINE_SIZE) std::atomic<int64_t> bottom;
+};
+
+
+
+class WorkStealingExecutor : public Executor
+{
+public:
+   //statistics of one worker thread
+   struct WorkerStats
+   {
+      uint64_t executed; //number of tasks run
+      uint64_t steals; //number of tasks stolen from other workers (their deques or inboxes)
+      uint64_t stealAttempts; //number of attempts to steal (successful or not)
+      uint64_t parks; //number of times the worker parked (as it had nothing to do)
+      size_t queueDepth; //number of tasks currently queued (deque and inbox)
+   };
+
+
+   //"threads" = 0 means one thread per core
+   explicit WorkStealingExecutor(size_t threads = 0, size_t queueCapacity = 1024)
+   {
+      if (threads == 0) threads = std::thread::hardware_concurrency();
+      if (threads == 0) threads = 1;
+      this->stopping = false;
+      this->idle = 0;
+      this->nextWorker = 0;
+      for (size_t i = 0; i < threads; i++) workers.push_back(new Worker(this, i, queueCapacity));
+      for (size_t i = 0; i < threads; i++) workers[i]->thread = std::thread(&WorkStealingExecutor::work, this, workers[i]);
+   }
+
+   //stops the worker threads. tasks that are still queued get run (by the calling thread, if need be)
+   ~WorkStealingExecutor()
+   {
+      stopping.store(true);
+      for (size_t i = 0; i < workers.size(); i++) wake(workers[i]);
+      for (size_t i = 0; i < workers.size(); i++) workers[i]->thread.join();
+      Task task;
+      bool found = true;
+      while (found)
+      {
+         found = false;
+         for (size_t i = 0; i < workers.size(); i++)
+         {
+            while (workers[i]->deque.pop(task) || workers[i]->inbox.pop(task))
+            {
+               task.run(task.context);
+               found = true;
+            }
+         }
+      }
+      for (size_t i = 0; i < workers.size(); i++) delete workers[i];
+   }
+
+
+   void execute(Task task)
+   {
+      Worker * self = currentWorker();
+      if ((self != nullptr) && (self->executor == this))
+      {
+         //spawned by one of our own workers: push it to the worker's own deque
+         if (self->deque.push(task))
+         {
+            wakeIdle(); //let an idle worker steal it
+            return;
+         }
+         task.run(task.context); //deque is full. run it right away
+         increment(self->executed);
+         return;
+      }
+      //submitted from outside: hand it over through the inbox of a worker (round robin)
+      size_t n = workers.size();
+      size_t first = nextWorker.fetch_add(1, std::memory_order_relaxed);
+      for (;;)
+      {
+         for (size_t i = 0; i < n; i++)
+         {
+            Worker * worker = workers[(first + i) % n];
+            if (worker->inbox.push(task))
+            {
+               if (!wake(worker)) wakeIdle(); //the worker is busy. let an idle one take it
+               return;
+            }
+         }
+         std::this_thread::yield(); //all inboxes are full
+      }
+   }
+
+
+   size_t threads() const
+   {
+      return workers.size();
+   }
+
+   //snapshot of the statistics of each worker
+   std::vector<WorkerStats> stats() const
+   {
+      std::vector<WorkerStats> result(workers.size());
+      for (size_t i = 0; i < workers.size(); i++)
+      {
+         Worker * worker = workers[i];
+         result[i].executed = worker->executed.load(std::memory_order_relaxed);
+         result[i].steals = worker->steals.load(std::memory_order_relaxed);
+         result[i].stealAttempts = worker->stealAttempts.load(std::memory_order_relaxed);
+         result[i].parks = worker->parks.load(std::memory_order_relaxed);
+         result[i].queueDepth = worker->deque.size() + worker->inbox.size();
+      }
+      return result;
+   }
+
+
+private:
+   WorkStealingExecutor(WorkStealingExecutor const &);
+   WorkStealingExecutor & operator=(WorkStealingExecutor const &);
+
+   static const size_t INBOX_TRANSFER = 32; //max. number of tasks moved from the inbox into the deque at once
+
+   struct Worker
+   {
+      Worker(WorkStealingExecutor * executor, size_t index, size_t capacity) : deque(capacity), inbox(capacity)
+      {
+         this->executor = executor;
+         this->random = (uint32_t)(index * 2654435761u + 1); //different seed for each worker
+         this->sleeping = false;
+         this->inboxTaken = false;
+         this->executed = 0;
+         this->steals = 0;
+         this->stealAttempts = 0;
+         this->parks = 0;
+      }
+
+      WorkStealingExecutor * executor;
+      TaskDeque deque;
+      MpscQueue<Task> inbox;
+      std::atomic<bool> inboxTaken; //a worker is draining the inbox (the queue has a single consumer at a time)
+      uint32_t random; //state of the random generator (to choose a victim)
+      std::atomic<bool> sleeping;
+      std::mutex mutex; //only used to park and wake
+      std::condition_variable wakeup;
+      std::thread thread;
+      //statistics. only written by the worker itself
+      std::atomic<uint64_t> executed;
+      std::atomic<uint64_t> steals;
+      std::atomic<uint64_t> stealAttempts;
+      std::atomic<uint64_t> parks;
+   };
+
+   std::vector<Worker *> workers;
+   std::atomic<size_t> nextWorker;
+   std::atomic<size_t> idle; //number of parked workers
+   std::atomic<bool> stopping;
+
+
+   //the worker, the calling thread is (or nullptr)
+   static Worker *& currentWorker()
+   {
+      static thread_local Worker * worker = nullptr;
+      return worker;
+   }
+
+   static void increment(std::atomic<uint64_t> & counter)
+   {
+      counter.store(counter.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+   }
+
+   //returns false, if the worker wasn't parked
+   bool wake(Worker * worker)
+   {
+      std::atomic_thread_fence(std::memory_order_seq_cst); //pairs with the fence in "park"
+      if (!worker->sleeping.load(std::memory_order_relaxed)) return false;
+      std::lock_guard<std::mutex> lock(worker->mutex);
+      worker->sleeping.store(false, std::memory_order_relaxed);
+      worker->wakeup.notify_one();
+      return true;
+   }
+
+   //wake one of the parked workers (if any), as there is something to steal
+   void wakeIdle()
+   {
+      std::atomic_thread_fence(std::memory_order_seq_cst); //pairs with the fence in "park"
+      if (idle.load(std::memory_order_relaxed) == 0) return;
+      for (size_t i = 0; i < workers.size(); i++)
+      {
+         if (workers[i]->sleeping.load(std::memory_order_relaxed))
+         {
+            wake(workers[i]);
+            return;
+         }
+      }
+   }
+
+   //take a task from the inbox of "owner" (any worker). some more are moved into the own deque.
+   //there, the other workers are able to steal them
+   bool takeInbox(Worker * self, Worker * owner, Task & task)
+   {
+      if (owner->inbox.empty()) return false;
+      if (owner->inboxTaken.exchange(true, std::memory_order_acquire)) return false; //another worker drains it
+      bool found = owner->inbox.pop(task);
+      if (found)
+      {
+         Task more;
+         for (size_t i = 1; (i < INBOX_TRANSFER) && owner->inbox.pop(more); i++)
+         {
+            if (!self->deque.push(more))
+            {
+               more.run(more.context); //deque is full
+               increment(self->executed);
+            }
+         }
+      }
+      owner->inboxTaken.store(false, std::memory_order_release);
+      if (found && (self->deque.size() > 0)) wakeIdle();
+      return found;
+   }
+
+   //get a task: own deque first, then the own inbox, then steal from the others (their deques, then their inboxes)
+   bool find(Worker * self, Task & task)
+   {
+      if (self->deque.pop(task)) return true;
+      if (takeInbox(self, self, task)) return true;
+      size_t n = workers.size();
+      if (n < 2) return false;
+      //start at a random victim, then try the others in turn
+      self->random ^= self->random << 13;
+      self->random ^= self->random >> 17;
+      self->random ^= self->random << 5;
+      size_t first = self->random % n;
+      for (size_t i = 0; i < n; i++)
+      {
+         Worker * victim = workers[(first + i) % n];
+         if (victim == self) continue;
+         increment(self->stealAttempts);
+         if (victim->deque.steal(task) || takeInbox(self, victim, task))
+         {
+            increment(self->steals);
+            return true;
+         }
+      }
+      return false;
+   }
+
+   //true, if there is any work to do for this worker
+   bool hasWork()
+   {
+      for (size_t i = 0; i < workers.size(); i++)
+      {
+         if ((workers[i]->deque.size() > 0) || !workers[i]->inbox.empty()) return true;
+      }
+      return false;
+   }
+
+   void park(Worker * self)
+   {
+      self->sleeping.store(true, std::memory_order_relaxed);
+      idle.fetch_add(1, std::memory_order_seq_cst);
+      std::atomic_thread_fence(std::memory_order_seq_cst); //pairs with the fence in "wake" (and "execute")
+      if (!hasWork() && !stopping.load())
+      {
+         increment(self->parks);
+         std::unique_lock<std::mutex> lock(self->mutex);
+         while (self->sleeping.load(std::memory_order_relaxed)) self->wakeup.wait(lock);
+      }
+      self->sleeping.store(false, std::memory_order_relaxed);
+      idle.fetch_sub(1, std::memory_order_seq_cst);
+   }
+
+   void work(Worker * self)
+   {
+      currentWorker() = self;
+      Task task;
+      for (;;)
+      {
+         if (find(self, task))
+         {
+            task.run(task.context);
+            increment(self->executed);
+            continue;
+         }
+         //nothing to do. try again a few times, before parking
+         bool found = false;
+         for (int spin = 0; (spin < 16) && !found; spin++)
+         {
+            std::this_thread::yield();
+            found = hasWork();
+         }
+         if (found) continue;
+         if (stopping.load()) return;
+         park(self);
+      }
+   }
+};
+
+#endif